@@ -0,0 +1,33 @@
+# Replays one trace with relay_bench -d in one replay mode and compares
+# the report dump with the checked-in traces/expected/<trace>.dump.
+# Run by the ctest entries in CMakeLists.txt:
+#
+#   cmake -P check_dump.cmake -DBENCH=<relay_bench> -DTRACE_DIR=<dir>
+#         -DTRACE=<name> -DMODE=plain|split|wired|wired_split
+
+if(MODE STREQUAL "split")
+	set(mode_args -s 1)
+elseif(MODE STREQUAL "wired")
+	set(mode_args -w)
+elseif(MODE STREQUAL "wired_split")
+	set(mode_args -w -s 3)
+else()
+	set(mode_args)
+endif()
+
+# Relative trace path, so the dump header does not depend on the tree
+execute_process(COMMAND ${BENCH} -d ${mode_args} ${TRACE}.txt
+		WORKING_DIRECTORY ${TRACE_DIR}
+		OUTPUT_VARIABLE actual
+		RESULT_VARIABLE rc)
+if(NOT rc EQUAL 0)
+	message(FATAL_ERROR "relay_bench failed on ${TRACE}.txt (${rc})")
+endif()
+
+file(READ ${TRACE_DIR}/expected/${TRACE}.dump expected)
+if(NOT actual STREQUAL expected)
+	file(WRITE ${TRACE}.${MODE}.dump "${actual}")
+	message(FATAL_ERROR "${TRACE}.txt (${MODE}): reports differ from "
+		"expected/${TRACE}.dump, got ${CMAKE_CURRENT_BINARY_DIR}/"
+		"${TRACE}.${MODE}.dump")
+endif()
@@ -0,0 +1,524 @@
+/*
+ * Host trace replay through the firmware input core.
+ *
+ * Each trace is a list of RX characteristic writes, one per line:
+ *
+ *   KP:0x41 KR:0x41     text write; space separated tokens are sent
+ *                       '\n' separated in a single write
+ *   x81 01 41 00        binary write, hex bytes
+ *   # ...               comment
+ *
+ * The writes are fed to relay_core_feed() with a mock HID sink that
+ * records every report. The default run replays each trace repeatedly
+ * and prints throughput; -d prints the report sequence of one replay
+ * instead, for diffing against a known-good run. -s switches the core
+ * to streaming mode (SM:1) and cuts every text write into pieces of the
+ * given size, so tokens straddle writes; the reports must not change.
+ * -w replays the trace as one byte stream through relay_core_feed_stream()
+ * instead, the way it arrives over CDC ACM: text writes end with '\n',
+ * binary frames run straight into whatever follows, and -s sets the
+ * chunk size (default: one chunk per recorded write).
+ *
+ *   relay_bench [-n passes] [-d] [-s bytes] [-w] trace...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define HAVE_CYCLES 1
+static inline uint64_t cycles(void) { return __rdtsc(); }
+#else
+#define HAVE_CYCLES 0
+static inline uint64_t cycles(void) { return 0; }
+#endif
+
+#include "relay_core.h"
+#include "qt_keymap.h"
+#include "kbd_type.h"
+#include "hid_km.h"
+
+#define DEFAULT_PASSES	2000
+#define LINE_MAX_LEN	4096
+#define WRITE_MAX	512	/* largest ATT attribute value */
+
+struct trace_write {
+	size_t len;
+	uint8_t data[WRITE_MAX];
+};
+
+struct trace {
+	const char *name;
+	struct trace_write *writes;
+	size_t count;
+};
+
+/* ---------------------------------------------------------------------------
+ * Mock HID sink
+ * ---------------------------------------------------------------------------
+ */
+enum mock_kind { MOCK_KBD, MOCK_ABS, MOCK_REL, MOCK_CONSUMER };
+
+struct mock_report {
+	enum mock_kind kind;
+	uint8_t modifiers;
+	uint8_t keys[RELAY_KBD_BITMAP_SIZE];
+	uint8_t buttons;
+	int32_t a, b;
+	int8_t wheel;
+};
+
+struct mock_sink {
+	struct mock_report *reports;
+	size_t count;
+	size_t cap;
+	bool record;		/* keep reports, or only count them */
+	uint64_t inputs;
+	uint64_t errors;
+};
+
+static struct mock_report *mock_next(struct mock_sink *s)
+{
+	if (!s->record) {
+		s->count++;
+		return NULL;
+	}
+	if (s->count == s->cap) {
+		s->cap = s->cap ? s->cap * 2 : 256;
+		s->reports = realloc(s->reports, s->cap * sizeof(*s->reports));
+		if (s->reports == NULL) {
+			perror("realloc");
+			exit(EXIT_FAILURE);
+		}
+	}
+	return &s->reports[s->count++];
+}
+
+static bool mock_kbd(void *ctx, uint8_t modifiers, const uint8_t *keys)
+{
+	struct mock_report *r = mock_next(ctx);
+
+	if (r) {
+		r->kind = MOCK_KBD;
+		r->modifiers = modifiers;
+		memcpy(r->keys, keys, RELAY_KBD_BITMAP_SIZE);
+	}
+	return true;
+}
+
+static bool mock_mouse_abs(void *ctx, uint8_t buttons, uint16_t x, uint16_t y,
+			   int8_t wheel)
+{
+	struct mock_report *r = mock_next(ctx);
+
+	if (r) {
+		*r = (struct mock_report){ .kind = MOCK_ABS, .buttons = buttons,
+					   .a = x, .b = y, .wheel = wheel };
+	}
+	return true;
+}
+
+static bool mock_mouse_rel(void *ctx, uint8_t buttons, int16_t dx, int16_t dy)
+{
+	struct mock_report *r = mock_next(ctx);
+
+	if (r) {
+		*r = (struct mock_report){ .kind = MOCK_REL, .buttons = buttons,
+					   .a = dx, .b = dy };
+	}
+	return true;
+}
+
+static bool mock_consumer(void *ctx, uint16_t usage)
+{
+	struct mock_report *r = mock_next(ctx);
+
+	if (r) {
+		*r = (struct mock_report){ .kind = MOCK_CONSUMER, .a = usage };
+	}
+	return true;
+}
+
+/*
+ * On-device typing runs src/kbd_type.c itself (UTF-8 decoding, keymap,
+ * press/release pairs), built against the stand-ins in zephyr_shim/.
+ * Its keyboard reports go to the sink of the text being typed; the
+ * queue never fills, so every piece is typed before the next arrives.
+ */
+static struct mock_sink *type_sink;
+
+bool hid_keyboard_send_keys(uint8_t modifiers, const uint8_t *bitmap)
+{
+	return mock_kbd(type_sink, modifiers, bitmap);
+}
+
+uint32_t hid_out_credits(void)
+{
+	return UINT32_MAX;
+}
+
+void hid_out_space_wait_init(struct hid_out_space_wait *w,
+			     hid_out_space_cb_t cb)
+{
+	(void)w;
+	(void)cb;
+}
+
+void hid_out_space_wait_arm(struct hid_out_space_wait *w, uint32_t credits)
+{
+	(void)w;
+	(void)credits;
+}
+
+static bool type_wake(void)
+{
+	return true;
+}
+
+static size_t mock_text(void *ctx, const uint8_t *utf8, size_t len)
+{
+	size_t n;
+
+	type_sink = ctx;
+	n = kbd_type_append(utf8, len);
+	kbd_type_service();
+	return n;
+}
+
+static bool mock_command(void *ctx, char action, uint32_t arg)
+{
+	(void)ctx;
+	(void)arg;
+	return action == 'L' || action == 'P' || action == 'Z';
+}
+
+static void mock_event(void *ctx, enum relay_core_event ev, uint32_t arg)
+{
+	struct mock_sink *s = ctx;
+
+	(void)arg;
+	if (ev == RELAY_EV_PARSED) {
+		s->inputs++;
+	} else if (ev != RELAY_EV_APPLIED) {
+		s->errors++;
+	}
+}
+
+static const struct relay_core_ops mock_ops = {
+	.kbd = mock_kbd,
+	.mouse_abs = mock_mouse_abs,
+	.mouse_rel = mock_mouse_rel,
+	.consumer = mock_consumer,
+	.command = mock_command,
+	.text = mock_text,
+	.event = mock_event,
+};
+
+static void mock_print(FILE *out, const struct mock_report *r)
+{
+	switch (r->kind) {
+	case MOCK_KBD:
+		fprintf(out, "K %02x", r->modifiers);
+		for (int u = 0; u < RELAY_KBD_BITMAP_SIZE * 8; u++) {
+			if (r->keys[u >> 3] & (1u << (u & 7))) {
+				fprintf(out, " %02x", u);
+			}
+		}
+		fputc('\n', out);
+		break;
+	case MOCK_ABS:
+		fprintf(out, "A %u %d %d %d\n", r->buttons, r->a, r->b, r->wheel);
+		break;
+	case MOCK_REL:
+		fprintf(out, "R %u %d %d\n", r->buttons, r->a, r->b);
+		break;
+	case MOCK_CONSUMER:
+		fprintf(out, "C %03x\n", r->a);
+		break;
+	}
+}
+
+/* ---------------------------------------------------------------------------
+ * Trace loading
+ * ---------------------------------------------------------------------------
+ */
+static bool parse_line(char *line, struct trace_write *w)
+{
+	char *p = line;
+
+	w->len = 0;
+
+	if (*p == 'x') {
+		p++;
+		while (*p) {
+			char *end;
+			unsigned long v = strtoul(p, &end, 16);
+
+			if (end == p) {
+				break;
+			}
+			if (w->len == sizeof(w->data) || v > 0xff) {
+				return false;
+			}
+			w->data[w->len++] = (uint8_t)v;
+			p = end;
+		}
+		return w->len > 0;
+	}
+
+	for (char *tok = strtok(p, " \t"); tok; tok = strtok(NULL, " \t")) {
+		size_t n = strlen(tok);
+
+		if (w->len + n + 1 > sizeof(w->data)) {
+			return false;
+		}
+		if (w->len) {
+			w->data[w->len++] = '\n';
+		}
+		memcpy(w->data + w->len, tok, n);
+		w->len += n;
+	}
+	return w->len > 0;
+}
+
+static bool load_trace(const char *path, struct trace *t)
+{
+	static char line[LINE_MAX_LEN];
+	FILE *f = fopen(path, "r");
+	size_t cap = 0;
+	int lineno = 0;
+
+	if (f == NULL) {
+		perror(path);
+		return false;
+	}
+
+	t->name = path;
+	t->writes = NULL;
+	t->count = 0;
+
+	while (fgets(line, sizeof(line), f)) {
+		line[strcspn(line, "\r\n")] = '\0';
+		lineno++;
+		if (line[0] == '#' || line[strspn(line, " \t")] == '\0') {
+			continue;
+		}
+		if (t->count == cap) {
+			cap = cap ? cap * 2 : 128;
+			t->writes = realloc(t->writes, cap * sizeof(*t->writes));
+			if (t->writes == NULL) {
+				perror("realloc");
+				exit(EXIT_FAILURE);
+			}
+		}
+		if (!parse_line(line, &t->writes[t->count])) {
+			fprintf(stderr, "%s:%d: bad or oversized write\n",
+				path, lineno);
+			fclose(f);
+			return false;
+		}
+		t->count++;
+	}
+
+	fclose(f);
+	return true;
+}
+
+/* ---------------------------------------------------------------------------
+ * Replay
+ * ---------------------------------------------------------------------------
+ */
+static double now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/* Write size for streaming mode, 0 to replay writes as recorded */
+static size_t split_size;
+
+static void replay_split(struct relay_core *core, const struct trace *t,
+			 struct mock_sink *sink)
+{
+	static const char stream_on[] = "SM:1\n";
+
+	relay_core_feed(core, stream_on, sizeof(stream_on) - 1, sink);
+	for (size_t i = 0; i < t->count; i++) {
+		const struct trace_write *w = &t->writes[i];
+
+		if (relay_proto_is_binary(w->data, w->len)) {
+			relay_core_feed(core, w->data, w->len, sink);
+			continue;
+		}
+		for (size_t off = 0; off < w->len; off += split_size) {
+			size_t n = w->len - off;
+
+			relay_core_feed(core, w->data + off,
+					n < split_size ? n : split_size, sink);
+		}
+		relay_core_feed(core, "\n", 1, sink);
+	}
+}
+
+/* Set by -w */
+static bool wired;
+
+static void stream_chunks(struct relay_core *core, struct relay_stream *st,
+			  const uint8_t *data, size_t len,
+			  struct mock_sink *sink)
+{
+	size_t chunk = split_size > 0 ? split_size : len;
+
+	for (size_t off = 0; off < len; off += chunk) {
+		size_t n = len - off;
+
+		relay_core_feed_stream(core, st, data + off,
+				       n < chunk ? n : chunk, sink);
+	}
+}
+
+static void replay_wired(struct relay_core *core, const struct trace *t,
+			 struct mock_sink *sink)
+{
+	static struct relay_stream st;
+
+	relay_core_stream_reset(&st);
+	for (size_t i = 0; i < t->count; i++) {
+		const struct trace_write *w = &t->writes[i];
+
+		stream_chunks(core, &st, w->data, w->len, sink);
+		if (!relay_proto_is_binary(w->data, w->len)) {
+			relay_core_feed_stream(core, &st, "\n", 1, sink);
+		}
+	}
+}
+
+static void replay(const struct trace *t, struct mock_sink *sink)
+{
+	struct relay_core core;
+
+	relay_core_init(&core, &mock_ops);
+	if (wired) {
+		replay_wired(&core, t, sink);
+		return;
+	}
+	if (split_size > 0) {
+		replay_split(&core, t, sink);
+		return;
+	}
+	for (size_t i = 0; i < t->count; i++) {
+		relay_core_feed(&core, t->writes[i].data, t->writes[i].len, sink);
+	}
+}
+
+static void dump(const struct trace *t)
+{
+	struct mock_sink sink = { .record = true };
+
+	replay(t, &sink);
+	printf("# %s: %zu writes, %llu inputs, %zu reports, %llu errors\n",
+	       t->name, t->count, (unsigned long long)sink.inputs, sink.count,
+	       (unsigned long long)sink.errors);
+	for (size_t i = 0; i < sink.count; i++) {
+		mock_print(stdout, &sink.reports[i]);
+	}
+	free(sink.reports);
+}
+
+static void bench(const struct trace *t, int passes)
+{
+	struct mock_sink sink = { .record = false };
+	double t0;
+	uint64_t c0;
+	double ns;
+	uint64_t cyc;
+
+	/* Warm-up pass, also sizes the per-pass counts */
+	replay(t, &sink);
+	uint64_t inputs = sink.inputs;
+	size_t reports = sink.count;
+
+	sink = (struct mock_sink){ .record = false };
+	t0 = now_ns();
+	c0 = cycles();
+	for (int p = 0; p < passes; p++) {
+		replay(t, &sink);
+	}
+	cyc = cycles() - c0;
+	ns = now_ns() - t0;
+
+	double events = (double)sink.inputs;
+
+	if (sink.inputs == 0) {
+		printf("%-24s no inputs\n", t->name);
+		return;
+	}
+
+	printf("%-24s %6zu writes %7llu inputs %7zu reports  "
+	       "%8.2f Mev/s %7.1f ns/ev",
+	       t->name, t->count, (unsigned long long)inputs, reports,
+	       events / ns * 1e3, ns / events);
+	if (HAVE_CYCLES) {
+		printf(" %7.1f cyc/ev", (double)cyc / events);
+	}
+	putchar('\n');
+}
+
+int main(int argc, char **argv)
+{
+	int passes = DEFAULT_PASSES;
+	bool dump_reports = false;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "n:ds:w")) != -1) {
+		switch (opt) {
+		case 'n':
+			passes = atoi(optarg);
+			break;
+		case 'd':
+			dump_reports = true;
+			break;
+		case 's':
+			split_size = (size_t)atoi(optarg);
+			break;
+		case 'w':
+			wired = true;
+			break;
+		default:
+			fprintf(stderr, "usage: %s [-n passes] [-d] [-s bytes] [-w] "
+				"trace...\n", argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind >= argc || passes <= 0) {
+		fprintf(stderr, "usage: %s [-n passes] [-d] [-s bytes] [-w] "
+			"trace...\n", argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	kbd_type_init(type_wake);
+
+	for (int i = optind; i < argc; i++) {
+		struct trace t;
+
+		if (!load_trace(argv[i], &t)) {
+			return EXIT_FAILURE;
+		}
+		if (dump_reports) {
+			dump(&t);
+		} else {
+			bench(&t, passes);
+		}
+		free(t.writes);
+	}
+
+	return EXIT_SUCCESS;
+}
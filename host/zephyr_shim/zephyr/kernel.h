@@ -0,0 +1,68 @@
+/*
+ * Just enough of the Zephyr kernel API to build src/kbd_type.c into the
+ * host tools. The bench is single-threaded, so atomics are plain loads
+ * and stores and spinlocks do nothing.
+ */
+
+#ifndef HOST_SHIM_ZEPHYR_KERNEL_H_
+#define HOST_SHIM_ZEPHYR_KERNEL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <zephyr/sys/util.h>
+#include <zephyr/sys/slist.h>
+
+typedef long atomic_t;
+typedef long atomic_val_t;
+
+static inline atomic_val_t atomic_get(const atomic_t *t) { return *t; }
+
+static inline atomic_val_t atomic_set(atomic_t *t, atomic_val_t v)
+{
+	atomic_val_t old = *t;
+
+	*t = v;
+	return old;
+}
+
+static inline atomic_val_t atomic_add(atomic_t *t, atomic_val_t v)
+{
+	atomic_val_t old = *t;
+
+	*t += v;
+	return old;
+}
+
+static inline atomic_val_t atomic_inc(atomic_t *t) { return atomic_add(t, 1); }
+static inline atomic_val_t atomic_clear(atomic_t *t) { return atomic_set(t, 0); }
+
+static inline bool atomic_cas(atomic_t *t, atomic_val_t old, atomic_val_t v)
+{
+	if (*t != old) {
+		return false;
+	}
+	*t = v;
+	return true;
+}
+
+struct k_spinlock {
+	int unused;
+};
+
+typedef int k_spinlock_key_t;
+
+static inline k_spinlock_key_t k_spin_lock(struct k_spinlock *l)
+{
+	(void)l;
+	return 0;
+}
+
+static inline void k_spin_unlock(struct k_spinlock *l, k_spinlock_key_t key)
+{
+	(void)l;
+	(void)key;
+}
+
+#endif /* HOST_SHIM_ZEPHYR_KERNEL_H_ */
@@ -0,0 +1,10 @@
+/* Host stand-in for <zephyr/sys/slist.h>, see ../kernel.h */
+
+#ifndef HOST_SHIM_ZEPHYR_SYS_SLIST_H_
+#define HOST_SHIM_ZEPHYR_SYS_SLIST_H_
+
+typedef struct _snode {
+	struct _snode *next;
+} sys_snode_t;
+
+#endif /* HOST_SHIM_ZEPHYR_SYS_SLIST_H_ */
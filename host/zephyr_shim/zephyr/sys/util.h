@@ -0,0 +1,12 @@
+/* Host stand-in for <zephyr/sys/util.h>, see ../kernel.h */
+
+#ifndef HOST_SHIM_ZEPHYR_SYS_UTIL_H_
+#define HOST_SHIM_ZEPHYR_SYS_UTIL_H_
+
+#define BIT(n)			(1UL << (n))
+#define MIN(a, b)		((a) < (b) ? (a) : (b))
+#define MAX(a, b)		((a) > (b) ? (a) : (b))
+#define IS_POWER_OF_TWO(x)	(((x) != 0) && (((x) & ((x) - 1)) == 0))
+#define BUILD_ASSERT(cond, ...)	_Static_assert(cond, "" __VA_ARGS__)
+
+#endif /* HOST_SHIM_ZEPHYR_SYS_UTIL_H_ */
@@ -0,0 +1,335 @@
+/*
+ * HID BLE Relay - BabbleSim central
+ *
+ * Stands in for the host application: finds the dongle by name,
+ * subscribes to TX and streams CONFIG_SIM_CENTRAL_TRACE with write
+ * without response at CONFIG_SIM_CENTRAL_WRITES_PER_SEC. Writes the
+ * stack refuses are not retried and count as dropped events, as they
+ * would be for a host that writes blindly. Every accepted write is
+ * logged as
+ *
+ *   W <seq> <t_us> <len> <events>
+ *
+ * in simulated time for sim/latency.py.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include <zephyr/bluetooth/uuid.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ble_hidrelay.h"
+#include "relay_proto.h"
+
+#define PEER_NAME	"HID BLE Relay"
+#define WRITE_MAX	244
+
+static const char trace_text[] = {
+#include "sim_trace.inc"
+	0
+};
+
+static struct bt_conn *peer;
+static uint16_t rx_handle;
+static uint16_t tx_handle;
+
+static K_SEM_DEFINE(ready_sem, 0, 1);
+
+static struct bt_uuid_128 rx_uuid = BT_UUID_INIT_128(BT_UUID_HIDRELAY_RX_VAL);
+static struct bt_uuid_128 tx_uuid = BT_UUID_INIT_128(BT_UUID_HIDRELAY_TX_VAL);
+
+static struct bt_gatt_discover_params disc_params;
+static struct bt_gatt_discover_params ccc_disc_params;
+static struct bt_gatt_subscribe_params sub_params;
+
+static inline uint64_t sim_now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+/* -----------------------------------------------------------------------------
+ * Trace: one write per line, same format as host/relay_bench
+ * -----------------------------------------------------------------------------
+ */
+static const char *trace_pos = trace_text;
+
+static void count_cb(const struct relay_input *in, void *ctx)
+{
+	ARG_UNUSED(in);
+	(*(int *)ctx)++;
+}
+
+/* Next write from the trace, wrapping at the end; returns its length */
+static size_t trace_next(uint8_t *buf, int *events)
+{
+	for (;;) {
+		const char *line = trace_pos;
+		const char *eol = strchr(line, '\n');
+		size_t llen = eol ? (size_t)(eol - line) : strlen(line);
+		size_t len = 0;
+
+		trace_pos = eol ? eol + 1 : trace_text;
+		if (llen == 0 || line[0] == '#') {
+			continue;
+		}
+
+		*events = 0;
+		if (line[0] == 'x') {
+			const char *p = line + 1;
+
+			while (p < line + llen && len < WRITE_MAX) {
+				char *end;
+				unsigned long v = strtoul(p, &end, 16);
+
+				if (end == p) {
+					break;
+				}
+				buf[len++] = (uint8_t)v;
+				p = end;
+			}
+			relay_proto_decode(buf, len, count_cb, events);
+			return len;
+		}
+
+		for (size_t i = 0; i < llen && len < WRITE_MAX; i++) {
+			bool sep = (line[i] == ' ' || line[i] == '\t');
+
+			if (sep && (len == 0 || buf[len - 1] == '\n')) {
+				continue;
+			}
+			buf[len++] = sep ? '\n' : line[i];
+		}
+		if (len > 0 && buf[len - 1] == '\n') {
+			len--;
+		}
+		for (size_t i = 0; i < len; i++) {
+			*events += (buf[i] == '\n');
+		}
+		*events += (len > 0);
+		return len;
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * GATT discovery and subscription
+ * -----------------------------------------------------------------------------
+ */
+static uint8_t notify_cb(struct bt_conn *conn,
+			 struct bt_gatt_subscribe_params *params,
+			 const void *data, uint16_t length)
+{
+	if (data) {
+		printk("TX %.*s", length, (const char *)data);
+	}
+	return BT_GATT_ITER_CONTINUE;
+}
+
+static void subscribed_cb(struct bt_conn *conn, uint8_t err,
+			  struct bt_gatt_subscribe_params *params)
+{
+	if (err) {
+		printk("Subscribe failed (err %u)\n", err);
+		return;
+	}
+	printk("Subscribed to TX\n");
+	k_sem_give(&ready_sem);
+}
+
+static uint8_t discover_cb(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			   struct bt_gatt_discover_params *params)
+{
+	int err;
+
+	if (attr) {
+		const struct bt_gatt_chrc *chrc = attr->user_data;
+
+		if (bt_uuid_cmp(chrc->uuid, &rx_uuid.uuid) == 0) {
+			rx_handle = chrc->value_handle;
+		} else if (bt_uuid_cmp(chrc->uuid, &tx_uuid.uuid) == 0) {
+			tx_handle = chrc->value_handle;
+		}
+		return BT_GATT_ITER_CONTINUE;
+	}
+
+	if (!rx_handle || !tx_handle) {
+		printk("hidrelay characteristics not found\n");
+		return BT_GATT_ITER_STOP;
+	}
+
+	sub_params.value_handle = tx_handle;
+	sub_params.ccc_handle = 0;	/* auto-discovered */
+	sub_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	sub_params.disc_params = &ccc_disc_params;
+	sub_params.value = BT_GATT_CCC_NOTIFY;
+	sub_params.notify = notify_cb;
+	sub_params.subscribe = subscribed_cb;
+
+	err = bt_gatt_subscribe(conn, &sub_params);
+	if (err) {
+		printk("Subscribe request failed (err %d)\n", err);
+	}
+	return BT_GATT_ITER_STOP;
+}
+
+/* -----------------------------------------------------------------------------
+ * Scanning and connection
+ * -----------------------------------------------------------------------------
+ */
+static bool ad_name_cb(struct bt_data *data, void *user_data)
+{
+	bool *match = user_data;
+
+	if (data->type == BT_DATA_NAME_COMPLETE &&
+	    data->data_len == strlen(PEER_NAME) &&
+	    memcmp(data->data, PEER_NAME, data->data_len) == 0) {
+		*match = true;
+		return false;
+	}
+	return true;
+}
+
+static void device_found(const bt_addr_le_t *addr, int8_t rssi, uint8_t type,
+			 struct net_buf_simple *ad)
+{
+	bool match = false;
+	int err;
+
+	if (peer || type != BT_GAP_ADV_TYPE_ADV_IND) {
+		return;
+	}
+
+	bt_data_parse(ad, ad_name_cb, &match);
+	if (!match) {
+		return;
+	}
+
+	if (bt_le_scan_stop()) {
+		return;
+	}
+
+	err = bt_conn_le_create(addr, BT_CONN_LE_CREATE_CONN,
+				BT_LE_CONN_PARAM_DEFAULT, &peer);
+	if (err) {
+		printk("Create connection failed (err %d)\n", err);
+	}
+}
+
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		printk("Connection failed (err 0x%02x)\n", err);
+		return;
+	}
+	printk("Connected\n");
+
+	disc_params.uuid = NULL;
+	disc_params.func = discover_cb;
+	disc_params.start_handle = BT_ATT_FIRST_ATTRIBUTE_HANDLE;
+	disc_params.end_handle = BT_ATT_LAST_ATTRIBUTE_HANDLE;
+	disc_params.type = BT_GATT_DISCOVER_CHARACTERISTIC;
+
+	err = bt_gatt_discover(conn, &disc_params);
+	if (err) {
+		printk("Discovery failed (err %d)\n", err);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	printk("Disconnected (reason 0x%02x)\n", reason);
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+			     uint16_t latency, uint16_t timeout)
+{
+	printk("Conn params: interval %u latency %u timeout %u\n",
+	       interval, latency, timeout);
+}
+
+BT_CONN_CB_DEFINE(conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+	.le_param_updated = le_param_updated,
+};
+
+/* -----------------------------------------------------------------------------
+ * Streaming
+ * -----------------------------------------------------------------------------
+ */
+static void stream(void)
+{
+	static uint8_t buf[WRITE_MAX];
+	const k_ticks_t period = k_us_to_ticks_ceil64(USEC_PER_SEC /
+						      CONFIG_SIM_CENTRAL_WRITES_PER_SEC);
+	const uint64_t end_us = sim_now_us() +
+				(uint64_t)CONFIG_SIM_CENTRAL_DURATION_S * USEC_PER_SEC;
+	k_ticks_t next = k_uptime_ticks();
+	uint32_t seq = 0, events = 0, dropped = 0, late = 0, bytes = 0;
+	uint64_t start_us = sim_now_us();
+
+	while (sim_now_us() < end_us) {
+		int n_events;
+		size_t len = trace_next(buf, &n_events);
+		uint64_t now = sim_now_us();
+		int err;
+
+		err = bt_gatt_write_without_response(peer, rx_handle, buf, len,
+						     false);
+		if (err) {
+			dropped += n_events;
+		} else {
+			printk("W %u %llu %u %d\n", seq++, now, len, n_events);
+			events += n_events;
+			bytes += len;
+		}
+
+		next += period;
+		if (k_uptime_ticks() > next) {
+			/* Fell behind the schedule, write blocked on buffers */
+			late++;
+			next = k_uptime_ticks();
+		}
+		k_sleep(K_TIMEOUT_ABS_TICKS(next));
+	}
+
+	uint64_t span = sim_now_us() - start_us;
+
+	printk("SUMMARY central writes %u events %u dropped %u late %u "
+	       "bytes %u span_us %llu\n", seq, events, dropped, late, bytes,
+	       span);
+	printk("SUMMARY central %llu events/s %llu bytes/s\n",
+	       (uint64_t)events * USEC_PER_SEC / span,
+	       (uint64_t)bytes * USEC_PER_SEC / span);
+}
+
+int main(void)
+{
+	int err;
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Failed to enable bluetooth: %d\n", err);
+		return err;
+	}
+
+	err = bt_le_scan_start(BT_LE_SCAN_PASSIVE, device_found);
+	if (err) {
+		printk("Scanning failed to start (err %d)\n", err);
+		return err;
+	}
+
+	k_sem_take(&ready_sem, K_FOREVER);
+
+	/* Give the peripheral's MTU / data length / parameter requests a moment */
+	k_sleep(K_MSEC(500));
+
+	stream();
+
+	/* Let the last writes drain before the peripheral prints its summary */
+	k_sleep(K_MSEC(200));
+	bt_conn_disconnect(peer, BT_HCI_ERR_REMOTE_USER_TERM_CONN);
+	return 0;
+}
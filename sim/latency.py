@@ -0,0 +1,60 @@
+#!/usr/bin/env python3
+"""Write-to-callback latency from a sim/run.sh run.
+
+Matches the central's "W <seq> <t_us> <len> <events>" lines against the
+peripheral's "W <seq> <t_us> <len>" lines. Both devices share BabbleSim's
+clock, so the difference is the time from the central handing a write
+to its stack until the dongle's received() callback runs: queueing for
+the next connection event, air time and the peripheral host stack.
+"""
+
+import sys
+
+
+def load(path):
+    writes = {}
+    with open(path, errors="replace") as f:
+        for line in f:
+            parts = line.split()
+            if len(parts) >= 4 and parts[0] == "W":
+                writes[int(parts[1])] = (int(parts[2]), int(parts[3]))
+    return writes
+
+
+def pct(sorted_vals, p):
+    idx = min(len(sorted_vals) - 1, int(len(sorted_vals) * p / 100))
+    return sorted_vals[idx]
+
+
+def main():
+    if len(sys.argv) != 3:
+        sys.exit("usage: latency.py central.log peripheral.log")
+
+    sent = load(sys.argv[1])
+    recv = load(sys.argv[2])
+    lat = []
+    mismatched = 0
+
+    for seq, (t_sent, length) in sent.items():
+        if seq not in recv:
+            continue
+        t_recv, rlen = recv[seq]
+        if rlen != length:
+            mismatched += 1
+        lat.append(t_recv - t_sent)
+
+    missing = len(sent) - len(lat)
+    print(f"writes: sent {len(sent)} received {len(recv)} "
+          f"missing {missing} length mismatches {mismatched}")
+    if not lat:
+        return
+
+    lat.sort()
+    print("write-to-callback us: "
+          f"min {lat[0]} p50 {pct(lat, 50)} p90 {pct(lat, 90)} "
+          f"p99 {pct(lat, 99)} max {lat[-1]} "
+          f"mean {sum(lat) / len(lat):.0f}")
+
+
+if __name__ == "__main__":
+    main()
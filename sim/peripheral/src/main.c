@@ -0,0 +1,189 @@
+/*
+ * HID BLE Relay - BabbleSim peripheral
+ *
+ * Runs the dongle's BLE receive path unchanged (hidrelay service,
+ * ble_link, relay_core) and replaces the USB HID interfaces with a sink
+ * that only counts reports. Every write is logged as
+ *
+ *   W <seq> <t_us> <len>
+ *
+ * in simulated time, which sim/latency.py matches against the central's
+ * log. A summary is printed when the central disconnects.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/bluetooth/bluetooth.h>
+#include <zephyr/bluetooth/conn.h>
+
+#include "ble_hidrelay.h"
+#include "ble_link.h"
+#include "relay_core.h"
+
+#define DEVICE_NAME		CONFIG_BT_DEVICE_NAME
+#define DEVICE_NAME_LEN		(sizeof(DEVICE_NAME) - 1)
+
+static const struct bt_data ad[] = {
+	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+	BT_DATA(BT_DATA_NAME_COMPLETE, DEVICE_NAME, DEVICE_NAME_LEN),
+};
+
+static const struct bt_data sd[] = {
+	BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_HIDRELAY_SVC_VAL),
+};
+
+struct sim_stats {
+	uint32_t writes;
+	uint32_t bytes;
+	uint32_t inputs;
+	uint32_t reports;
+	uint32_t errors;
+	uint64_t first_us;
+	uint64_t last_us;
+};
+
+static struct sim_stats stats;
+static struct relay_core input_core;
+
+static inline uint64_t sim_now_us(void)
+{
+	return k_ticks_to_us_floor64(k_uptime_ticks());
+}
+
+static bool sink_kbd(void *ctx, uint8_t modifiers, const uint8_t *keys)
+{
+	stats.reports++;
+	return true;
+}
+
+static bool sink_mouse_abs(void *ctx, uint8_t buttons, uint16_t x, uint16_t y,
+			   int8_t wheel)
+{
+	stats.reports++;
+	return true;
+}
+
+static bool sink_mouse_rel(void *ctx, uint8_t buttons, int16_t dx, int16_t dy)
+{
+	stats.reports++;
+	return true;
+}
+
+static bool sink_command(void *ctx, char action, uint32_t arg)
+{
+	return action == 'L' || action == 'P' || action == 'Z';
+}
+
+static void sink_event(void *ctx, enum relay_core_event ev, uint32_t arg)
+{
+	if (ev == RELAY_EV_PARSED) {
+		stats.inputs++;
+	} else if (ev != RELAY_EV_APPLIED) {
+		stats.errors++;
+	}
+}
+
+static const struct relay_core_ops sink_ops = {
+	.kbd = sink_kbd,
+	.mouse_abs = sink_mouse_abs,
+	.mouse_rel = sink_mouse_rel,
+	.command = sink_command,
+	.event = sink_event,
+};
+
+static void received(struct bt_conn *conn, const void *data, uint16_t len,
+		     void *ctx)
+{
+	uint64_t now = sim_now_us();
+
+	ARG_UNUSED(ctx);
+
+	if (stats.writes == 0) {
+		stats.first_us = now;
+	}
+	stats.last_us = now;
+	stats.bytes += len;
+	printk("W %u %llu %u\n", stats.writes++, now, len);
+
+	ble_link_activity(conn);
+	relay_core_feed(&input_core, data, len, conn);
+}
+
+static void notif_enabled(bool enabled, void *ctx)
+{
+	ARG_UNUSED(ctx);
+	printk("TX notify %s\n", enabled ? "enabled" : "disabled");
+	relay_core_resync(&input_core);
+}
+
+static struct bt_hidrelay_cb hidrelay_cb = {
+	.notif_enabled = notif_enabled,
+	.received      = received,
+};
+
+static void link_changed(struct bt_conn *conn)
+{
+	char report[48];
+
+	ble_link_format(conn, report, sizeof(report));
+	printk("%s", report);
+}
+
+static void print_summary(void)
+{
+	uint64_t span = stats.last_us - stats.first_us;
+
+	printk("SUMMARY peripheral writes %u bytes %u inputs %u reports %u "
+	       "errors %u span_us %llu\n", stats.writes, stats.bytes,
+	       stats.inputs, stats.reports, stats.errors, span);
+	if (span > 0) {
+		printk("SUMMARY peripheral %llu inputs/s %llu bytes/s\n",
+		       (uint64_t)stats.inputs * USEC_PER_SEC / span,
+		       (uint64_t)stats.bytes * USEC_PER_SEC / span);
+	}
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	printk("Disconnected (reason 0x%02x)\n", reason);
+	print_summary();
+	stats = (struct sim_stats){ 0 };
+}
+
+BT_CONN_CB_DEFINE(sim_conn_callbacks) = {
+	.disconnected = disconnected,
+};
+
+int main(void)
+{
+	int err;
+
+	relay_core_init(&input_core, &sink_ops);
+
+	err = bt_enable(NULL);
+	if (err) {
+		printk("Failed to enable bluetooth: %d\n", err);
+		return err;
+	}
+
+	err = ble_link_init(link_changed);
+	if (err) {
+		printk("Failed to init BLE link management (err %d)\n", err);
+		return err;
+	}
+
+	err = bt_hidrelay_init(&hidrelay_cb, NULL);
+	if (err) {
+		printk("Failed to register HIDRelay cb (err %d)\n", err);
+		return err;
+	}
+
+	err = bt_le_adv_start(BT_LE_ADV_CONN, ad, ARRAY_SIZE(ad), sd,
+			      ARRAY_SIZE(sd));
+	if (err) {
+		printk("Advertising failed to start (err %d)\n", err);
+		return err;
+	}
+	printk("Advertising started\n");
+
+	return 0;
+}
@@ -0,0 +1,29 @@
+#!/bin/sh
+# Build the simulated peripheral and central for nrf52_bsim and run them
+# in BabbleSim. Needs a Zephyr/NCS workspace with BabbleSim installed
+# (BSIM_OUT_PATH and BSIM_COMPONENTS_PATH set).
+#
+#   sim/run.sh [extra cmake args for the central, e.g.
+#               -DCONFIG_SIM_CENTRAL_WRITES_PER_SEC=1000
+#               -DCONFIG_SIM_CENTRAL_TRACE=\"binary.txt\"]
+set -e
+
+: "${BSIM_OUT_PATH:?BSIM_OUT_PATH must point at the BabbleSim install}"
+
+TOP=$(cd "$(dirname "$0")/.." && pwd)
+OUT=${SIM_OUT:-$TOP/build-sim}
+SIM_ID=hidrelay_$$
+# Simulated time limit, generous compared to the streaming duration
+SIM_LENGTH_US=${SIM_LENGTH_US:-60000000}
+
+west build -b nrf52_bsim -d "$OUT/peripheral" "$TOP/sim/peripheral"
+west build -b nrf52_bsim -d "$OUT/central" "$TOP/sim/central" -- "$@"
+
+cd "$BSIM_OUT_PATH/bin"
+./bs_2G4_phy_v1 -s="$SIM_ID" -D=2 -sim_length="$SIM_LENGTH_US" &
+"$OUT/peripheral/zephyr/zephyr.exe" -s="$SIM_ID" -d=0 > "$OUT/peripheral.log" 2>&1 &
+"$OUT/central/zephyr/zephyr.exe" -s="$SIM_ID" -d=1 > "$OUT/central.log" 2>&1 &
+wait
+
+grep SUMMARY "$OUT/central.log" "$OUT/peripheral.log" || true
+python3 "$TOP/sim/latency.py" "$OUT/central.log" "$OUT/peripheral.log"
@@ -5,7 +5,7 @@
 
 #include <zephyr/kernel.h>
 #include <zephyr/logging/log.h>
-LOG_MODULE_REGISTER(hidrelay, LOG_LEVEL_INF);
+LOG_MODULE_REGISTER(hidrelay, CONFIG_HIDRELAY_BLE_LOG_LEVEL);
 
 #include <zephyr/bluetooth/gatt.h>
 #include <zephyr/bluetooth/conn.h>
@@ -113,3 +113,9 @@ int bt_hidrelay_send(struct bt_conn *conn, const void *data, uint16_t len)
 
 	return bt_gatt_notify(conn, &hidrelay_svc.attrs[4], data, len);
 }
+
+bool bt_hidrelay_subscribed(struct bt_conn *conn)
+{
+	return bt_gatt_is_subscribed(conn, &hidrelay_svc.attrs[4],
+				     BT_GATT_CCC_NOTIFY);
+}
@@ -41,7 +41,12 @@ extern "C" {
  */
 
 struct bt_hidrelay_cb {
-	/** @brief TX Notify : Change Subscription (Notify On/Off) */
+	/**
+	 * @brief TX Notify : Change Subscription (Notify On/Off)
+	 *
+	 * Over all connections: on when the first central subscribes, off
+	 * when the last one leaves. See bt_hidrelay_subscribed().
+	 */
 	void (*notif_enabled)(bool enabled, void *user_data);
 
 	/** @brief RX Write Event (Central -> Peripheral) */
@@ -76,6 +81,11 @@ int bt_hidrelay_init(const struct bt_hidrelay_cb *cb, void *user_data);
  */
 int bt_hidrelay_send(struct bt_conn *conn, const void *data, uint16_t len);
 
+/**
+ * @brief Whether @p conn has TX notifications enabled
+ */
+bool bt_hidrelay_subscribed(struct bt_conn *conn);
+
 #ifdef __cplusplus
 }
 #endif
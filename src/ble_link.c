@@ -0,0 +1,328 @@
+/*
+ * HID Relay BLE link management
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(ble_link, CONFIG_HIDRELAY_BLE_LOG_LEVEL);
+
+#include <zephyr/bluetooth/conn.h>
+#include <zephyr/bluetooth/gatt.h>
+#include "ble_link.h"
+
+/* BLE minimums, in effect until the exchanges complete */
+#define LINK_DEFAULT_MTU	23
+#define LINK_DEFAULT_OCTETS	27
+#define LINK_DEFAULT_TIME_US	328
+
+/* Connection parameters, interval in 1.25 ms units, timeout in 10 ms */
+#define LINK_ACTIVE_INTERVAL	6	/* 7.5 ms, the BLE minimum */
+#define LINK_SUPERVISION_TIMEOUT 400	/* 4 s */
+
+BUILD_ASSERT((1 + CONFIG_HIDRELAY_CONN_IDLE_LATENCY) *
+	     CONFIG_HIDRELAY_CONN_IDLE_INTERVAL * 125 * 2 <
+	     LINK_SUPERVISION_TIMEOUT * 1000,
+	     "Idle interval and latency exceed the supervision timeout");
+
+enum link_pm_state {
+	LINK_PM_ACTIVE,
+	LINK_PM_IDLE,
+};
+
+/* One per connection, indexed by bt_conn_index() */
+struct link_slot {
+	struct bt_conn *conn;
+	struct ble_link_info info;	/* under link_lock */
+	atomic_t pm_state;
+	atomic_t last_activity;
+	struct k_work active_work;
+	struct k_work_delayable idle_work;
+	struct bt_gatt_exchange_params mtu_params;
+};
+
+static struct link_slot link_slots[CONFIG_BT_MAX_CONN];
+static ble_link_changed_cb_t link_changed;
+static struct k_spinlock link_lock;
+
+static inline struct link_slot *link_slot_of(struct bt_conn *conn)
+{
+	return &link_slots[bt_conn_index(conn)];
+}
+
+static void link_info_reset(struct ble_link_info *info)
+{
+	info->att_mtu = LINK_DEFAULT_MTU;
+	info->tx_octets = LINK_DEFAULT_OCTETS;
+	info->tx_time_us = LINK_DEFAULT_TIME_US;
+	info->rx_octets = LINK_DEFAULT_OCTETS;
+	info->rx_time_us = LINK_DEFAULT_TIME_US;
+	info->interval = 0;
+	info->latency = 0;
+	info->timeout = 0;
+}
+
+static void notify_changed(struct bt_conn *conn)
+{
+	if (link_changed) {
+		link_changed(conn);
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * ATT MTU
+ * -----------------------------------------------------------------------------
+ */
+static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err,
+			    struct bt_gatt_exchange_params *params)
+{
+	ARG_UNUSED(params);
+
+	if (err) {
+		LOG_WRN("MTU exchange failed (err %u)", err);
+	}
+}
+
+static void att_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx)
+{
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+
+	link_slot_of(conn)->info.att_mtu = MIN(tx, rx);
+	k_spin_unlock(&link_lock, key);
+
+	LOG_INF("ATT MTU updated: tx %u rx %u", tx, rx);
+	notify_changed(conn);
+}
+
+static struct bt_gatt_cb gatt_cb = {
+	.att_mtu_updated = att_mtu_updated,
+};
+
+/* -----------------------------------------------------------------------------
+ * Activity-driven connection parameters
+ *
+ * ble_link_activity() only stores a timestamp unless the link is idle.
+ * The idle check is a delayable work item per connection that re-arms
+ * itself for the remaining time instead of being rescheduled on every
+ * write. Each central is relaxed on its own input, not the others'.
+ * -----------------------------------------------------------------------------
+ */
+static struct bt_conn *link_slot_conn_get(struct link_slot *slot)
+{
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+	struct bt_conn *conn = slot->conn ? bt_conn_ref(slot->conn) : NULL;
+
+	k_spin_unlock(&link_lock, key);
+	return conn;
+}
+
+static void link_pm_request(struct link_slot *slot, enum link_pm_state state)
+{
+	struct bt_conn *conn = link_slot_conn_get(slot);
+	struct bt_le_conn_param param = {
+		.interval_min = LINK_ACTIVE_INTERVAL,
+		.interval_max = LINK_ACTIVE_INTERVAL,
+		.latency = 0,
+		.timeout = LINK_SUPERVISION_TIMEOUT,
+	};
+	int err;
+
+	if (conn == NULL) {
+		return;
+	}
+
+	if (state == LINK_PM_IDLE) {
+		param.interval_min = CONFIG_HIDRELAY_CONN_IDLE_INTERVAL;
+		param.interval_max = CONFIG_HIDRELAY_CONN_IDLE_INTERVAL;
+		param.latency = CONFIG_HIDRELAY_CONN_IDLE_LATENCY;
+	}
+
+	err = bt_conn_le_param_update(conn, &param);
+	if (err) {
+		LOG_WRN("Conn param update (%s) failed (err %d)",
+			state == LINK_PM_IDLE ? "idle" : "active", err);
+	}
+	bt_conn_unref(conn);
+}
+
+/* Idle -> active, on the first write after an idle period */
+static void link_pm_work_handler(struct k_work *work)
+{
+	struct link_slot *slot = CONTAINER_OF(work, struct link_slot,
+					      active_work);
+
+	link_pm_request(slot, LINK_PM_ACTIVE);
+	k_work_reschedule(&slot->idle_work,
+			  K_MSEC(CONFIG_HIDRELAY_CONN_IDLE_TIMEOUT_MS));
+}
+
+static void link_pm_idle_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct link_slot *slot = CONTAINER_OF(dwork, struct link_slot,
+					      idle_work);
+	uint32_t idle_ms = k_uptime_get_32() -
+			   (uint32_t)atomic_get(&slot->last_activity);
+
+	if (idle_ms < CONFIG_HIDRELAY_CONN_IDLE_TIMEOUT_MS) {
+		k_work_reschedule(dwork,
+				  K_MSEC(CONFIG_HIDRELAY_CONN_IDLE_TIMEOUT_MS -
+					 idle_ms));
+		return;
+	}
+
+	if (atomic_cas(&slot->pm_state, LINK_PM_ACTIVE, LINK_PM_IDLE)) {
+		LOG_INF("Input idle, relaxing connection %u",
+			(unsigned int)(slot - link_slots));
+		link_pm_request(slot, LINK_PM_IDLE);
+	}
+}
+
+void ble_link_activity(struct bt_conn *conn)
+{
+	struct link_slot *slot = link_slot_of(conn);
+
+	atomic_set(&slot->last_activity, (atomic_val_t)k_uptime_get_32());
+
+	if (atomic_cas(&slot->pm_state, LINK_PM_IDLE, LINK_PM_ACTIVE)) {
+		k_work_submit(&slot->active_work);
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Connection callbacks
+ * -----------------------------------------------------------------------------
+ */
+static void connected(struct bt_conn *conn, uint8_t err)
+{
+	int ret;
+
+	if (err) {
+		return;
+	}
+
+	struct link_slot *slot = link_slot_of(conn);
+	struct bt_conn_info info;
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+
+	if (slot->conn == NULL) {
+		slot->conn = bt_conn_ref(conn);
+	}
+	link_info_reset(&slot->info);
+	if (bt_conn_get_info(conn, &info) == 0) {
+		slot->info.interval = info.le.interval;
+		slot->info.latency = info.le.latency;
+		slot->info.timeout = info.le.timeout;
+	}
+	k_spin_unlock(&link_lock, key);
+
+	/* Ask for the largest PDU first so the MTU exchange rides on it */
+	ret = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+	if (ret) {
+		LOG_WRN("Data length update request failed (err %d)", ret);
+	}
+
+	ret = bt_gatt_exchange_mtu(conn, &slot->mtu_params);
+	if (ret) {
+		LOG_WRN("MTU exchange request failed (err %d)", ret);
+	}
+
+	/* A new session is expected to start sending input right away */
+	atomic_set(&slot->pm_state, LINK_PM_IDLE);
+	ble_link_activity(conn);
+}
+
+static void disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct link_slot *slot = link_slot_of(conn);
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+
+	if (slot->conn == conn) {
+		bt_conn_unref(slot->conn);
+		slot->conn = NULL;
+	}
+	link_info_reset(&slot->info);
+	k_spin_unlock(&link_lock, key);
+
+	k_work_cancel_delayable(&slot->idle_work);
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval,
+			     uint16_t latency, uint16_t timeout)
+{
+	struct ble_link_info *li = &link_slot_of(conn)->info;
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+
+	li->interval = interval;
+	li->latency = latency;
+	li->timeout = timeout;
+	k_spin_unlock(&link_lock, key);
+
+	LOG_INF("Conn params updated: interval %u latency %u timeout %u",
+		interval, latency, timeout);
+	notify_changed(conn);
+}
+
+static void le_data_len_updated(struct bt_conn *conn,
+				struct bt_conn_le_data_len_info *info)
+{
+	struct ble_link_info *li = &link_slot_of(conn)->info;
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+
+	li->tx_octets = info->tx_max_len;
+	li->tx_time_us = info->tx_max_time;
+	li->rx_octets = info->rx_max_len;
+	li->rx_time_us = info->rx_max_time;
+	k_spin_unlock(&link_lock, key);
+
+	LOG_INF("Data length updated: tx %u/%u us rx %u/%u us",
+		info->tx_max_len, info->tx_max_time,
+		info->rx_max_len, info->rx_max_time);
+	notify_changed(conn);
+}
+
+BT_CONN_CB_DEFINE(link_conn_callbacks) = {
+	.connected = connected,
+	.disconnected = disconnected,
+	.le_param_updated = le_param_updated,
+	.le_data_len_updated = le_data_len_updated,
+};
+
+/* -----------------------------------------------------------------------------
+ * API
+ * -----------------------------------------------------------------------------
+ */
+int ble_link_init(ble_link_changed_cb_t changed)
+{
+	link_changed = changed;
+	for (size_t i = 0; i < ARRAY_SIZE(link_slots); i++) {
+		struct link_slot *slot = &link_slots[i];
+
+		link_info_reset(&slot->info);
+		k_work_init(&slot->active_work, link_pm_work_handler);
+		k_work_init_delayable(&slot->idle_work, link_pm_idle_handler);
+		slot->mtu_params.func = mtu_exchange_cb;
+	}
+	bt_gatt_cb_register(&gatt_cb);
+	return 0;
+}
+
+void ble_link_get_info(struct bt_conn *conn, struct ble_link_info *info)
+{
+	k_spinlock_key_t key = k_spin_lock(&link_lock);
+
+	*info = link_slot_of(conn)->info;
+	k_spin_unlock(&link_lock, key);
+}
+
+int ble_link_format(struct bt_conn *conn, char *buf, size_t len)
+{
+	struct ble_link_info info;
+	int n;
+
+	ble_link_get_info(conn, &info);
+	n = snprintk(buf, len, "LP:%u,%u,%u,%u,%u,%u,%u\n", info.att_mtu,
+		     info.tx_octets, info.tx_time_us,
+		     info.rx_octets, info.rx_time_us,
+		     info.interval, info.latency);
+	return MIN(n, (int)len - 1);
+}
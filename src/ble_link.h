@@ -0,0 +1,68 @@
+/*
+ * HID Relay BLE link management
+ *
+ * Tracks each connected central (up to CONFIG_BT_MAX_CONN) and
+ * negotiates the largest ATT MTU and LL data length its link supports, so
+ * the host can pack many events into a single write.
+ *
+ * Connection parameters follow input activity, per connection: the
+ * shortest interval with no peripheral latency while writes arrive, and
+ * a longer interval with peripheral latency after
+ * CONFIG_HIDRELAY_CONN_IDLE_TIMEOUT_MS of silence.
+ */
+
+#ifndef HIDRELAY_BLE_LINK_H_
+#define HIDRELAY_BLE_LINK_H_
+
+#include <stddef.h>
+#include <zephyr/bluetooth/conn.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct ble_link_info {
+	uint16_t att_mtu;
+	uint16_t tx_octets;
+	uint16_t tx_time_us;
+	uint16_t rx_octets;
+	uint16_t rx_time_us;
+	uint16_t interval;	/* 1.25 ms units */
+	uint16_t latency;	/* connection events */
+	uint16_t timeout;	/* 10 ms units */
+};
+
+/** @brief Called (from the BT stack) when negotiated link values change */
+typedef void (*ble_link_changed_cb_t)(struct bt_conn *conn);
+
+/**
+ * @brief Register link callbacks
+ *
+ * @return 0 on success, negative on error
+ */
+int ble_link_init(ble_link_changed_cb_t changed);
+
+/**
+ * @brief Note input activity on @p conn
+ *
+ * Cheap enough to call for every write; switches the connection back to
+ * the low-latency parameters if it had been relaxed.
+ */
+void ble_link_activity(struct bt_conn *conn);
+
+/** @brief Negotiated values for the link to @p conn */
+void ble_link_get_info(struct bt_conn *conn, struct ble_link_info *info);
+
+/**
+ * @brief Render the values for @p conn as
+ *        "LP:<mtu>,<tx>,<tx_us>,<rx>,<rx_us>,<interval>,<latency>\n"
+ *
+ * @return number of characters written
+ */
+int ble_link_format(struct bt_conn *conn, char *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIDRELAY_BLE_LINK_H_ */
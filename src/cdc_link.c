@@ -0,0 +1,203 @@
+/*
+ * HID Relay CDC ACM link
+ *
+ * The TX ring has the same producer/consumer split as the HID report
+ * queues: writers append under a spinlock, the UART interrupt callback
+ * consumes without one and turns the TX interrupt off once the ring is
+ * empty. Writers turn it back on after every append.
+ *
+ * The RX ring is the other way round: the callback reads the UART FIFO
+ * straight into it and posts the rx callback, one reader thread takes
+ * the bytes out. When it is full the callback turns the RX interrupt
+ * off and the reader turns it back on once it has made room.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/drivers/uart.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "cdc_link.h"
+
+#define CDC_TX_BUF_SIZE		CONFIG_HIDRELAY_CDC_TX_BUF_SIZE
+#define CDC_TX_BUF_MASK		(CDC_TX_BUF_SIZE - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CDC_TX_BUF_SIZE),
+	     "CONFIG_HIDRELAY_CDC_TX_BUF_SIZE must be a power of two");
+
+#define CDC_RX_BUF_SIZE		CONFIG_HIDRELAY_CDC_RX_BUF_SIZE
+#define CDC_RX_BUF_MASK		(CDC_RX_BUF_SIZE - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(CDC_RX_BUF_SIZE),
+	     "CONFIG_HIDRELAY_CDC_RX_BUF_SIZE must be a power of two");
+
+static const struct device *cdc_dev;
+static cdc_link_rx_cb_t cdc_rx;
+
+static uint8_t tx_buf[CDC_TX_BUF_SIZE];
+static atomic_t tx_head;
+static atomic_t tx_tail;
+static struct k_spinlock tx_prod_lock;
+
+static uint8_t rx_buf[CDC_RX_BUF_SIZE];
+static atomic_t rx_head;
+static atomic_t rx_tail;
+static atomic_t rx_stalled;
+
+static atomic_t tx_sent;
+static atomic_t tx_dropped;
+static atomic_t rx_received;
+
+/* Hand the UART the longest contiguous run it takes */
+static void cdc_tx_fill(const struct device *dev)
+{
+	atomic_val_t tail = atomic_get(&tx_tail);
+	size_t used = (size_t)(atomic_get(&tx_head) - tail);
+	size_t run;
+	int n;
+
+	if (used == 0) {
+		uart_irq_tx_disable(dev);
+		/* A writer may have appended and enabled in between */
+		if (atomic_get(&tx_head) != tail) {
+			uart_irq_tx_enable(dev);
+		}
+		return;
+	}
+
+	run = MIN(used, CDC_TX_BUF_SIZE - (tail & CDC_TX_BUF_MASK));
+	n = uart_fifo_fill(dev, &tx_buf[tail & CDC_TX_BUF_MASK], run);
+	if (n > 0) {
+		atomic_set(&tx_tail, tail + n);
+		atomic_add(&tx_sent, n);
+	}
+}
+
+/* Move what the UART holds into the RX ring, as far as it fits */
+static void cdc_rx_fill(const struct device *dev)
+{
+	bool got = false;
+
+	for (;;) {
+		atomic_val_t head = atomic_get(&rx_head);
+		size_t free = CDC_RX_BUF_SIZE -
+			      (size_t)(head - atomic_get(&rx_tail));
+		size_t run;
+		int n;
+
+		if (free == 0) {
+			uart_irq_rx_disable(dev);
+			atomic_set(&rx_stalled, 1);
+			/* The reader may have made room in between */
+			if (atomic_get(&rx_tail) + CDC_RX_BUF_SIZE != head &&
+			    atomic_cas(&rx_stalled, 1, 0)) {
+				uart_irq_rx_enable(dev);
+			}
+			break;
+		}
+
+		run = MIN(free, CDC_RX_BUF_SIZE - (head & CDC_RX_BUF_MASK));
+		n = uart_fifo_read(dev, &rx_buf[head & CDC_RX_BUF_MASK], run);
+		if (n <= 0) {
+			break;
+		}
+		atomic_set(&rx_head, head + n);
+		atomic_add(&rx_received, n);
+		got = true;
+	}
+
+	if (got && cdc_rx != NULL) {
+		cdc_rx();
+	}
+}
+
+static void cdc_link_irq_cb(const struct device *dev, void *user_data)
+{
+	ARG_UNUSED(user_data);
+
+	while (uart_irq_update(dev) && uart_irq_is_pending(dev)) {
+		bool rx = uart_irq_rx_ready(dev);
+		bool tx = uart_irq_tx_ready(dev);
+
+		if (!rx && !tx) {
+			break;
+		}
+		if (rx) {
+			cdc_rx_fill(dev);
+		}
+		if (tx) {
+			cdc_tx_fill(dev);
+		}
+	}
+}
+
+int cdc_link_init(const struct device *dev, cdc_link_rx_cb_t rx)
+{
+	if (!device_is_ready(dev)) {
+		return -ENODEV;
+	}
+
+	cdc_rx = rx;
+	uart_irq_callback_user_data_set(dev, cdc_link_irq_cb, NULL);
+	cdc_dev = dev;
+	uart_irq_rx_enable(dev);
+	return 0;
+}
+
+bool cdc_link_write(const char *buf, size_t len)
+{
+	k_spinlock_key_t key;
+	atomic_val_t head;
+	size_t used, first;
+	bool queued = false;
+
+	if (cdc_dev == NULL || len == 0) {
+		return false;
+	}
+
+	key = k_spin_lock(&tx_prod_lock);
+	head = atomic_get(&tx_head);
+	used = (size_t)(head - atomic_get(&tx_tail));
+	if (len <= CDC_TX_BUF_SIZE - used) {
+		first = MIN(len, CDC_TX_BUF_SIZE - (head & CDC_TX_BUF_MASK));
+		memcpy(&tx_buf[head & CDC_TX_BUF_MASK], buf, first);
+		memcpy(tx_buf, buf + first, len - first);
+		atomic_set(&tx_head, head + len);
+		queued = true;
+	}
+	k_spin_unlock(&tx_prod_lock, key);
+
+	if (!queued) {
+		atomic_inc(&tx_dropped);
+		return false;
+	}
+
+	/* The callback disables it again once the ring runs dry */
+	uart_irq_tx_enable(cdc_dev);
+	return true;
+}
+
+size_t cdc_link_read(uint8_t *buf, size_t len)
+{
+	atomic_val_t tail = atomic_get(&rx_tail);
+	size_t n = MIN(len, (size_t)(atomic_get(&rx_head) - tail));
+	size_t first = MIN(n, CDC_RX_BUF_SIZE - (tail & CDC_RX_BUF_MASK));
+
+	memcpy(buf, &rx_buf[tail & CDC_RX_BUF_MASK], first);
+	memcpy(buf + first, rx_buf, n - first);
+	atomic_set(&rx_tail, tail + n);
+
+	if (n > 0 && atomic_cas(&rx_stalled, 1, 0)) {
+		uart_irq_rx_enable(cdc_dev);
+	}
+	return n;
+}
+
+void cdc_link_get_stats(struct cdc_link_stats *stats)
+{
+	stats->pending = (uint32_t)(atomic_get(&tx_head) -
+				    atomic_get(&tx_tail));
+	stats->sent = (uint32_t)atomic_get(&tx_sent);
+	stats->dropped = (uint32_t)atomic_get(&tx_dropped);
+	stats->received = (uint32_t)atomic_get(&rx_received);
+}
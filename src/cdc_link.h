@@ -0,0 +1,74 @@
+/*
+ * HID Relay CDC ACM link
+ *
+ * Diagnostics output over the cdc_acm_uart0 port. Writes go into a ring
+ * drained by the UART TX interrupt and never wait: a message that does
+ * not fit (no terminal attached, host not reading) is dropped whole and
+ * counted, so output can never stall the input path.
+ *
+ * Received bytes are collected in an RX ring from the UART callback and
+ * read out with cdc_link_read() from a thread. While the ring is full
+ * the port stops reading, so the host is held off instead of losing
+ * bytes.
+ */
+
+#ifndef HIDRELAY_CDC_LINK_H_
+#define HIDRELAY_CDC_LINK_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <zephyr/device.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct cdc_link_stats {
+	uint32_t pending;	/* bytes waiting in the TX ring */
+	uint32_t sent;		/* bytes handed to the UART */
+	uint32_t dropped;	/* messages that did not fit */
+	uint32_t received;	/* bytes read from the port */
+};
+
+/**
+ * @brief New bytes wait for cdc_link_read()
+ *
+ * Called from the UART callback, which may be an ISR: must not block.
+ */
+typedef void (*cdc_link_rx_cb_t)(void);
+
+/**
+ * @brief Take over the UART interrupt callback of @p dev
+ *
+ * @param rx called when bytes arrive, NULL to ignore them
+ *
+ * @return 0 on success, -ENODEV if the device is not ready
+ */
+int cdc_link_init(const struct device *dev, cdc_link_rx_cb_t rx);
+
+/**
+ * @brief Take up to @p len received bytes, in order
+ *
+ * Single reader; call from a thread after the rx callback.
+ *
+ * @return bytes copied, 0 once the RX ring is empty
+ */
+size_t cdc_link_read(uint8_t *buf, size_t len);
+
+/**
+ * @brief Queue @p len bytes for output, all or nothing
+ *
+ * Never blocks; callable from any thread.
+ *
+ * @return true if queued, false if dropped
+ */
+bool cdc_link_write(const char *buf, size_t len);
+
+void cdc_link_get_stats(struct cdc_link_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIDRELAY_CDC_LINK_H_ */
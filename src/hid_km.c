@@ -1,37 +1,70 @@
 #include "hid_km.h"
 #include "usb_hid_keys.h"
+#include "latency.h"
 
 #include <zephyr/kernel.h>
 #include <zephyr/device.h>
+#include <zephyr/sys/util.h>
+#include <zephyr/logging/log.h>
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/uart.h>
 
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+#include <zephyr/usb/class/usbd_hid.h>
+#else
 #include <zephyr/usb/usb_device.h>
 #include <zephyr/usb/class/usb_hid.h>
+#endif
 
 #include <string.h>
 
-typedef struct {
-    uint32_t qt_key;
-    uint8_t hid_key;
-    uint8_t modifier;
-} qt_to_hid_mapping_t;
+LOG_MODULE_REGISTER(hid_km, CONFIG_HIDRELAY_HID_LOG_LEVEL);
 
 #define HID_REPORT_SIZE_M 6
 #define HID_REPORT_SIZE_T 7
 #define HID_REPORT_SIZE_K 8
 
-#define HID_MOD_LCTRL  KEY_MOD_LCTRL
-#define HID_MOD_LSHIFT KEY_MOD_LSHIFT
-#define HID_MOD_LALT   KEY_MOD_LALT
-#define HID_MOD_LMETA  KEY_MOD_LMETA
-#define HID_MOD_RCTRL  KEY_MOD_RCTRL
-#define HID_MOD_RSHIFT KEY_MOD_RSHIFT
-#define HID_MOD_RALT   KEY_MOD_RALT
-#define HID_MOD_RMETA  KEY_MOD_RMETA
+/* Report IDs on the composite interface */
+#define HID_REPORT_ID_KBD	1
+#define HID_REPORT_ID_MOUSE	2
+#define HID_REPORT_ID_CONSUMER	3
+
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+BUILD_ASSERT(CONFIG_USB_HID_DEVICE_COUNT == 1,
+	     "Composite HID uses a single interface (HID_0)");
+
+/* Every report starts with its ID */
+#define HID_ID_LEN		1
+/* The mouse shares the keyboard's interface and queue */
+#define HID_EP_MOUSE		HID_IFACE_KBD
+#else
+#define HID_ID_LEN		0
+#define HID_EP_MOUSE		HID_IFACE_MOUSE
+#endif
+
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+/* Modifier byte + one bit per usage 0x00..0xA7 */
+#define HID_NKRO_KEY_USAGES	0xA8
+#define HID_REPORT_SIZE_NKRO	(1 + HID_NKRO_KEY_USAGES / 8)
+#define HID_OUT_REPORT_MAX	(HID_ID_LEN + HID_REPORT_SIZE_NKRO)
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+BUILD_ASSERT(DT_PROP(DT_NODELABEL(hid_dev_0), in_report_size) >=
+	     HID_OUT_REPORT_MAX,
+	     "NKRO report does not fit hid_dev_0 in-report-size");
+#else
+BUILD_ASSERT(CONFIG_HID_INTERRUPT_EP_MPS >= HID_OUT_REPORT_MAX,
+	     "NKRO report does not fit the HID interrupt endpoint");
+#endif
+BUILD_ASSERT(HID_NKRO_KEY_USAGES / 8 <= HID_KBD_BITMAP_SIZE);
+#else
+#define HID_OUT_REPORT_MAX	(HID_ID_LEN + HID_REPORT_SIZE_K)
+#endif
+
 #define DataVarAbs 0x02
 
 
+#if !defined(CONFIG_HIDRELAY_HID_COMPOSITE)
 static const uint8_t hid_mouse_abs_report_desc[]={
     0x05, 0x01,        /* Usage Page (Generic Desktop) */
     0x09, 0x02,        /* Usage (Mouse) */
@@ -82,366 +115,1197 @@ static const uint8_t hid_mouse_abs_report_desc[]={
       0xc0,           /*   End Collection (Physical) */
     0xc0              /* End Collection (Application) */
 };
+#endif
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+BUILD_ASSERT(DT_NODE_EXISTS(DT_NODELABEL(hid_dev_2)),
+	     "Relative mouse needs hid_dev_2, see usbd-mouse-rel.overlay");
+#else
+BUILD_ASSERT(CONFIG_USB_HID_DEVICE_COUNT >= 3,
+	     "Relative mouse needs a third HID interface (HID_2)");
+#endif
+
+static const uint8_t hid_mouse_rel_report_desc[]={
+    0x05, 0x01,        /* Usage Page (Generic Desktop) */
+    0x09, 0x02,        /* Usage (Mouse) */
+    0xa1, 0x01,        /* Collection (Application) */
+      0x09, 0x01,      /*   Usage (Pointer) */
+      0xa1, 0x00,      /*   Collection (Physical) */
 
+        /* Buttons (Left, Right, Middle) */
+        0x05, 0x09,    /*     Usage Page (Button) */
+        0x19, 0x01,    /*     Usage Minimum (Button 1) */
+        0x29, 0x03,    /*     Usage Maximum (Button 3) */
+        0x15, 0x00,    /*     Logical Minimum (0) */
+        0x25, 0x01,    /*     Logical Maximum (1) */
+        0x95, 0x03,    /*     Report Count (3 buttons) */
+        0x75, 0x01,    /*     Report Size (1 bit) */
+        0x81, 0x02,    /*     Input (Data,Var,Abs) */
 
+        0x95, 0x01,
+        0x75, 0x05,
+        0x81, 0x03,    /*     Input (Cnst,Var,Abs) */
 
-const qt_to_hid_mapping_t qt_hid_map[] = {
-    // ----------------------------
-    // Regular Keys and Symbols
-    // ----------------------------
-    
-    // Space
-    {0x20, KEY_SPACE, 0}, // Qt::Key_Space
-
-    // Symbols with Shift modifiers
-    {0x21, KEY_1, HID_MOD_LSHIFT}, // Qt::Key_Exclam '!'
-    {0x22, KEY_APOSTROPHE, HID_MOD_LSHIFT}, // Qt::Key_QuoteDbl '"'
-    {0x23, KEY_3, HID_MOD_LSHIFT}, // Qt::Key_NumberSign '#'
-    {0x24, KEY_4, HID_MOD_LSHIFT}, // Qt::Key_Dollar '$'
-    {0x25, KEY_5, HID_MOD_LSHIFT}, // Qt::Key_Percent '%'
-    {0x26, KEY_7, HID_MOD_LSHIFT}, // Qt::Key_Ampersand '&'
-    {0x27, KEY_APOSTROPHE, 0}, // Qt::Key_Apostrophe '''
-    {0x28, KEY_9, HID_MOD_LSHIFT}, // Qt::Key_ParenLeft '('
-    {0x29, KEY_0, HID_MOD_LSHIFT}, // Qt::Key_ParenRight ')'
-    {0x2a, KEY_KPASTERISK, 0}, // Qt::Key_Asterisk '*'
-    {0x2b, KEY_EQUAL, HID_MOD_LSHIFT}, // Qt::Key_Plus '+'
-    {0x2c, KEY_COMMA, 0}, // Qt::Key_Comma ','
-    {0x2d, KEY_MINUS, 0}, // Qt::Key_Minus '-'
-    {0x2e, KEY_DOT, 0}, // Qt::Key_Period '.'
-    {0x2f, KEY_SLASH, 0}, // Qt::Key_Slash '/'
-
-    // Numbers
-    {0x30, KEY_0, 0}, // Qt::Key_0 '0'
-    {0x31, KEY_1, 0}, // Qt::Key_1 '1'
-    {0x32, KEY_2, 0}, // Qt::Key_2 '2'
-    {0x33, KEY_3, 0}, // Qt::Key_3 '3'
-    {0x34, KEY_4, 0}, // Qt::Key_4 '4'
-    {0x35, KEY_5, 0}, // Qt::Key_5 '5'
-    {0x36, KEY_6, 0}, // Qt::Key_6 '6'
-    {0x37, KEY_7, 0}, // Qt::Key_7 '7'
-    {0x38, KEY_8, 0}, // Qt::Key_8 '8'
-    {0x39, KEY_9, 0}, // Qt::Key_9 '9'
-
-    // More Symbols
-    {0x3a, KEY_SEMICOLON, HID_MOD_LSHIFT}, // Qt::Key_Colon ':'
-    {0x3b, KEY_SEMICOLON, 0}, // Qt::Key_Semicolon ';'
-    {0x3c, KEY_COMMA, HID_MOD_LSHIFT}, // Qt::Key_Less '<'
-    {0x3d, KEY_EQUAL, 0}, // Qt::Key_Equal '='
-    {0x3e, KEY_DOT, HID_MOD_LSHIFT}, // Qt::Key_Greater '>'
-    {0x3f, KEY_SLASH, HID_MOD_LSHIFT}, // Qt::Key_Question '?'
-    {0x40, KEY_2, HID_MOD_LSHIFT}, // Qt::Key_At '@'
-    // Letters
-    {0x41, KEY_A, 0}, // Qt::Key_A 'A'
-    {0x42, KEY_B, 0}, // Qt::Key_B 'B'
-    {0x43, KEY_C, 0}, // Qt::Key_C 'C'
-    {0x44, KEY_D, 0}, // Qt::Key_D 'D'
-    {0x45, KEY_E, 0}, // Qt::Key_E 'E'
-    {0x46, KEY_F, 0}, // Qt::Key_F 'F'
-    {0x47, KEY_G, 0}, // Qt::Key_G 'G'
-    {0x48, KEY_H, 0}, // Qt::Key_H 'H'
-    {0x49, KEY_I, 0}, // Qt::Key_I 'I'
-    {0x4a, KEY_J, 0}, // Qt::Key_J 'J'
-    {0x4b, KEY_K, 0}, // Qt::Key_K 'K'
-    {0x4c, KEY_L, 0}, // Qt::Key_L 'L'
-    {0x4d, KEY_M, 0}, // Qt::Key_M 'M'
-    {0x4e, KEY_N, 0}, // Qt::Key_N 'N'
-    {0x4f, KEY_O, 0}, // Qt::Key_O 'O'
-    {0x50, KEY_P, 0}, // Qt::Key_P 'P'
-    {0x51, KEY_Q, 0}, // Qt::Key_Q 'Q'
-    {0x52, KEY_R, 0}, // Qt::Key_R 'R'
-    {0x53, KEY_S, 0}, // Qt::Key_S 'S'
-    {0x54, KEY_T, 0}, // Qt::Key_T 'T'
-    {0x55, KEY_U, 0}, // Qt::Key_U 'U'
-    {0x56, KEY_V, 0}, // Qt::Key_V 'V'
-    {0x57, KEY_W, 0}, // Qt::Key_W 'W'
-    {0x58, KEY_X, 0}, // Qt::Key_X 'X'
-    {0x59, KEY_Y, 0}, // Qt::Key_Y 'Y'
-    {0x5a, KEY_Z, 0}, // Qt::Key_Z 'Z'
-
-    // Additional Symbols
-    {0x5b, KEY_LEFTBRACE, 0}, // Qt::Key_BracketLeft '['
-    {0x5c, KEY_BACKSLASH, 0}, // Qt::Key_Backslash '\'
-    {0x5d, KEY_RIGHTBRACE, 0}, // Qt::Key_BracketRight ']'
-    {0x5e, KEY_GRAVE, HID_MOD_LSHIFT}, // Qt::Key_AsciiCircum '^'
-    {0x5f, KEY_MINUS, HID_MOD_LSHIFT}, // Qt::Key_Underscore '_'
-    {0x60, KEY_GRAVE, 0}, // Qt::Key_QuoteLeft '`'
-
-    {0x7b, KEY_LEFTBRACE, HID_MOD_LSHIFT}, // Qt::Key_BraceLeft '{'
-    {0x7c, KEY_BACKSLASH, HID_MOD_LSHIFT}, // Qt::Key_Bar '|'
-    {0x7d, KEY_RIGHTBRACE, HID_MOD_LSHIFT}, // Qt::Key_BraceRight '}'
-    {0x7e, KEY_GRAVE, HID_MOD_LSHIFT}, // Qt::Key_AsciiTilde '~'
-
-    // ----------------------------
-    // Function Keys
-    // ----------------------------
-    {0x01000030, KEY_F1, 0}, // Qt::Key_F1
-    {0x01000031, KEY_F2, 0}, // Qt::Key_F2
-    {0x01000032, KEY_F3, 0}, // Qt::Key_F3
-    {0x01000033, KEY_F4, 0}, // Qt::Key_F4
-    {0x01000034, KEY_F5, 0}, // Qt::Key_F5
-    {0x01000035, KEY_F6, 0}, // Qt::Key_F6
-    {0x01000036, KEY_F7, 0}, // Qt::Key_F7
-    {0x01000037, KEY_F8, 0}, // Qt::Key_F8
-    {0x01000038, KEY_F9, 0}, // Qt::Key_F9
-    {0x01000039, KEY_F10, 0}, // Qt::Key_F10
-    {0x0100003a, KEY_F11, 0}, // Qt::Key_F11
-    {0x0100003b, KEY_F12, 0}, // Qt::Key_F12
-    {0x0100003c, KEY_F13, 0}, // Qt::Key_F13
-    {0x0100003d, KEY_F14, 0}, // Qt::Key_F14
-    {0x0100003e, KEY_F15, 0}, // Qt::Key_F15
-    {0x0100003f, KEY_F16, 0}, // Qt::Key_F16
-    {0x01000040, KEY_F17, 0}, // Qt::Key_F17
-    {0x01000041, KEY_F18, 0}, // Qt::Key_F18
-    {0x01000042, KEY_F19, 0}, // Qt::Key_F19
-    {0x01000043, KEY_F20, 0}, // Qt::Key_F20
-    {0x01000044, KEY_F21, 0}, // Qt::Key_F21
-    {0x01000045, KEY_F22, 0}, // Qt::Key_F22
-    {0x01000046, KEY_F23, 0}, // Qt::Key_F23
-    {0x01000047, KEY_F24, 0}, // Qt::Key_F24
-    {0x01000048, KEY_NONE, 0}, // Qt::Key_F25
-    {0x01000049, KEY_NONE, 0}, // Qt::Key_F26
-    {0x0100004a, KEY_NONE, 0}, // Qt::Key_F27
-    {0x0100004b, KEY_NONE, 0}, // Qt::Key_F28
-    {0x0100004c, KEY_NONE, 0}, // Qt::Key_F29
-    {0x0100004d, KEY_NONE, 0}, // Qt::Key_F30
-    {0x0100004e, KEY_NONE, 0}, // Qt::Key_F31
-    {0x0100004f, KEY_NONE, 0}, // Qt::Key_F32
-    {0x01000050, KEY_NONE, 0}, // Qt::Key_F33
-    {0x01000051, KEY_NONE, 0}, // Qt::Key_F34
-    {0x01000052, KEY_NONE, 0}, // Qt::Key_F35
-
-    // ----------------------------
-    // Modifier Keys
-    // ----------------------------
-    {0x01000020, KEY_LEFTSHIFT, HID_MOD_LSHIFT}, // Qt::Key_Shift
-    {0x01000021, KEY_LEFTCTRL, HID_MOD_LCTRL},   // Qt::Key_Control
-    {0x01000022, KEY_LEFTMETA, HID_MOD_LMETA},   // Qt::Key_Meta
-    {0x01000023, KEY_LEFTALT, HID_MOD_LALT},     // Qt::Key_Alt
-    {0x01001103, KEY_RIGHTALT, HID_MOD_RALT},    // Qt::Key_AltGr
-
-    // ----------------------------
-    // Lock Keys
-    // ----------------------------
-    {0x01000024, KEY_CAPSLOCK, 0}, // Qt::Key_CapsLock
-    {0x01000025, KEY_NUMLOCK, 0}, // Qt::Key_NumLock
-    {0x01000026, KEY_SCROLLLOCK, 0}, // Qt::Key_ScrollLock
-
-    // ----------------------------
-    // Special Keys
-    // ----------------------------
-    {0x01000000, KEY_ESC, 0}, // Qt::Key_Escape
-    {0x01000001, KEY_TAB, 0}, // Qt::Key_Tab
-    {0x01000002, KEY_BACKSPACE, 0}, // Qt::Key_Backtab
-    {0x01000003, KEY_BACKSPACE, 0}, // Qt::Key_Backspace
-    {0x01000004, KEY_ENTER, 0}, // Qt::Key_Return
-    {0x01000005, KEY_KPENTER, 0}, // Qt::Key_Enter
-    {0x01000006, KEY_INSERT, 0}, // Qt::Key_Insert
-    {0x01000007, KEY_DELETE, 0}, // Qt::Key_Delete
-    {0x01000008, KEY_PAUSE, 0}, // Qt::Key_Pause
-    {0x01000009, KEY_SYSRQ, 0}, // Qt::Key_Print
-    {0x0100000a, KEY_SYSRQ, 0}, // Qt::Key_SysReq
-    // {0x0100000b, KEY_CLEAR, 0}, // Qt::Key_Clear
-
-    {0x01000010, KEY_HOME, 0}, // Qt::Key_Home
-    {0x01000011, KEY_END, 0}, // Qt::Key_End
-    {0x01000012, KEY_LEFT, 0}, // Qt::Key_Left
-    {0x01000013, KEY_UP, 0}, // Qt::Key_Up
-    {0x01000014, KEY_RIGHT, 0}, // Qt::Key_Right
-    {0x01000015, KEY_DOWN, 0}, // Qt::Key_Down
-    {0x01000016, KEY_PAGEUP, 0}, // Qt::Key_PageUp
-    {0x01000017, KEY_PAGEDOWN, 0}, // Qt::Key_PageDown
-
-    {0x01000053, KEY_FRONT, 0}, // Qt::Key_Super_L
-    {0x01000054, KEY_FRONT, 0}, // Qt::Key_Super_R
-    {0x01000055, KEY_PROPS, 0}, // Qt::Key_Menu
-    {0x01000056, KEY_NONE, 0}, // Qt::Key_Hyper_L
-    {0x01000057, KEY_NONE, 0}, // Qt::Key_Hyper_R
-    {0x01000058, KEY_HELP, 0}, // Qt::Key_Help
-    {0x01000059, KEY_NONE, 0}, // Qt::Key_Direction_L
-    {0x01000060, KEY_NONE, 0}, // Qt::Key_Direction_R
-
-    // ----------------------------
-    // Additional Special Keys
-    // ----------------------------
-    {0x0a0, KEY_NONE, 0}, // Qt::Key_nobreakspace
-    {0x0a1, KEY_NONE, 0}, // Qt::Key_exclamdown
-    {0x0a2, KEY_NONE, 0}, // Qt::Key_cent
-    {0x0a3, KEY_NONE, 0}, // Qt::Key_sterling
-    {0x0a4, KEY_NONE, 0}, // Qt::Key_currency
-    {0x0a5, KEY_YEN, 0}, // Qt::Key_yen
-    {0x0a6, KEY_NONE, 0}, // Qt::Key_brokenbar
-    {0x0a7, KEY_NONE, 0}, // Qt::Key_section
-    {0x0a8, KEY_NONE, 0}, // Qt::Key_diaeresis
-    {0x0a9, KEY_NONE, 0}, // Qt::Key_copyright
-    {0x0aa, KEY_NONE, 0}, // Qt::Key_ordfeminine
-    {0x0ab, KEY_NONE, 0}, // Qt::Key_guillemotleft
-    {0x0ac, KEY_NONE, 0}, // Qt::Key_notsign
-    {0x0ad, KEY_NONE, 0}, // Qt::Key_hyphen
-    {0x0ae, KEY_NONE, 0}, // Qt::Key_registered
-    {0x0af, KEY_NONE, 0}, // Qt::Key_macron
-    {0x0b0, KEY_NONE, 0}, // Qt::Key_degree
-    {0x0b1, KEY_NONE, 0}, // Qt::Key_plusminus
-    {0x0b2, KEY_NONE, 0}, // Qt::Key_twosuperior
-    {0x0b3, KEY_NONE, 0}, // Qt::Key_threesuperior
-    {0x0b4, KEY_NONE, 0}, // Qt::Key_acute
-    {0x0b5, KEY_NONE, 0}, // Qt::Key_micro
-    {0x0b6, KEY_NONE, 0}, // Qt::Key_paragraph
-    {0x0b7, KEY_NONE, 0}, // Qt::Key_periodcentered
-    {0x0b8, KEY_NONE, 0}, // Qt::Key_cedilla
-    {0x0b9, KEY_NONE, 0}, // Qt::Key_onesuperior
-    {0x0ba, KEY_NONE, 0}, // Qt::Key_masculine
-    {0x0bb, KEY_NONE, 0}, // Qt::Key_guillemotright
-    {0x0bc, KEY_NONE, 0}, // Qt::Key_onequarter
-    {0x0bd, KEY_NONE, 0}, // Qt::Key_onehalf
-    {0x0be, KEY_NONE, 0}, // Qt::Key_threequarters
-    {0x0bf, KEY_NONE, 0}, // Qt::Key_questiondown
-
-    {0x0c0, KEY_NONE, 0}, // Qt::Key_Agrave
-    {0x0c1, KEY_NONE, 0}, // Qt::Key_Aacute
-    {0x0c2, KEY_NONE, 0}, // Qt::Key_Acircumflex
-    {0x0c3, KEY_NONE, 0}, // Qt::Key_Atilde
-    {0x0c4, KEY_NONE, 0}, // Qt::Key_Adiaeresis
-    {0x0c5, KEY_NONE, 0}, // Qt::Key_Aring
-    {0x0c6, KEY_NONE, 0}, // Qt::Key_AE
-    {0x0c7, KEY_NONE, 0}, // Qt::Key_Ccedilla
-    {0x0c8, KEY_NONE, 0}, // Qt::Key_Egrave
-    {0x0c9, KEY_NONE, 0}, // Qt::Key_Eacute
-    {0x0ca, KEY_NONE, 0}, // Qt::Key_Ecircumflex
-    {0x0cb, KEY_NONE, 0}, // Qt::Key_Ediaeresis
-    {0x0cc, KEY_NONE, 0}, // Qt::Key_Igrave
-    {0x0cd, KEY_NONE, 0}, // Qt::Key_Iacute
-    {0x0ce, KEY_NONE, 0}, // Qt::Key_Icircumflex
-    {0x0cf, KEY_NONE, 0}, // Qt::Key_Idiaeresis
-    {0x0d0, KEY_NONE, 0}, // Qt::Key_ETH
-    {0x0d1, KEY_NONE, 0}, // Qt::Key_Ntilde
-    {0x0d2, KEY_NONE, 0}, // Qt::Key_Ograve
-    {0x0d3, KEY_NONE, 0}, // Qt::Key_Oacute
-    {0x0d4, KEY_NONE, 0}, // Qt::Key_Ocircumflex
-    {0x0d5, KEY_NONE, 0}, // Qt::Key_Otilde
-    {0x0d6, KEY_O, 0}, // Qt::Key_Odiaeresis 'Ö' mapped to 'O'
-    {0x0d7, KEY_KPMINUS, 0}, // Qt::Key_multiply '×' mapped to Keypad Minus
-    // {0x0d8, KEY_OOBLIQUE, 0}, // Qt::Key_Ooblique 'Ø'
-    {0x0d9, KEY_U, 0}, // Qt::Key_Ugrave 'Ù' mapped to 'U'
-    {0x0da, KEY_U, 0}, // Qt::Key_Uacute 'Ú' mapped to 'U'
-    {0x0db, KEY_U, 0}, // Qt::Key_Ucircumflex 'Û' mapped to 'U'
-    {0x0dc, KEY_U, 0}, // Qt::Key_Udiaeresis 'Ü' mapped to 'U'
-    {0x0dd, KEY_Y, 0}, // Qt::Key_Yacute 'Ý' mapped to 'Y'
-    {0x0de, KEY_NONE, 0}, // Qt::Key_THORN 'Þ'
-    {0x0df, KEY_NONE, 0}, // Qt::Key_ssharp 'ß'
-    // {0x0f7, KEY_DIVISION, 0}, // Qt::Key_division '÷'
-    {0x0ff, KEY_NONE, 0}, // Qt::Key_ydiaeresis 'ÿ'
-
-    // ----------------------------
-    // Media and Additional Keys (Optional)
-    // ----------------------------
-    // Depending on your application's needs, you can map additional media keys here.
-    // Example:
-    // {0x... , KEY_MEDIA_PLAYPAUSE, 0}, // Qt::Key_Media_PlayPause
-    // {0x... , KEY_MEDIA_VOLUMEUP, 0}, // Qt::Key_Media_VolumeUp
-    // Add more as needed.
-
-    // ----------------------------
-    // Unmapped or Unsupported Keys
-    // ----------------------------
-    // Keys that do not have a direct HID equivalent are mapped to KEY_NONE.
-    // You can handle these cases as needed in your application logic.
-    
-    // Example:
-    // {0x01000053, KEY_NONE, 0}, // Qt::Key_Super_L (already mapped as KEY_FRONT)
-    // {0x01000054, KEY_NONE, 0}, // Qt::Key_Super_R (already mapped as KEY_FRONT)
-    // etc.
+        /* X, Y Relative */
+        0x05, 0x01,    /*     Usage Page (Generic Desktop) */
+        0x09, 0x30,    /*     Usage (X) */
+        0x09, 0x31,    /*     Usage (Y) */
+        0x16, 0x01, 0x80, /*  Logical Min (-32767) */
+        0x26, 0xFF, 0x7F, /*  Logical Max (32767) */
+        0x75, 0x10,    /*     Report Size (16 bits) */
+        0x95, 0x02,    /*     Report Count (2) */
+        0x81, 0x06,    /*     Input (Data,Var,Rel) */
+
+        // Wheel
+        0x09, 0x38,    //   Usage (Wheel)
+        0x15, 0x81,    //   Logical Minimum (-127)
+        0x25, 0x7F,    //   Logical Maximum (127)
+        0x75, 0x08,    //   Report Size (8 bit)
+        0x95, 0x01,    //   Report Count (1)
+        0x81, 0x06,    //   Input (Data,Var,Rel)
+
+      0xc0,           /*   End Collection (Physical) */
+    0xc0              /* End Collection (Application) */
 };
+#endif
+
+
+
+
+
+/*
+ * Outbound report queues
+ *
+ * Each HID interface has its own endpoint, its own completion tracking
+ * and its own ring of finished reports. Reports are built by the caller
+ * (BLE RX context, main loop) and copied into the ring; hid_out_thread is
+ * the only consumer and the only code that touches the endpoints, so
+ * producers never block on USB and a busy mouse endpoint never holds up
+ * the keyboard.
+ *
+ * Each ring is single-producer/single-consumer: head is only advanced by
+ * the producer side, tail only by the consumer. Since both the BLE RX
+ * thread and the main loop emit reports, producers are serialized with a
+ * spinlock; the consumer side takes no lock.
+ *
+ * Absolute pointer motion is coalesced: a report that only moves the
+ * pointer goes into a single "latest" slot instead of the ring, replacing
+ * any motion the endpoint has not picked up yet. Button transitions and
+ * wheel deltas still go through the ring in order. The host therefore
+ * always sees the newest position, and USB load is bounded by the poll
+ * rate rather than by how fast the BLE host streams moves. Relative
+ * motion is coalesced the same way, except deltas are summed.
+ *
+ * With CONFIG_HIDRELAY_USBD_NEXT the endpoint is driven through the usbd
+ * stack instead. It sends straight from our buffer and can hold up to
+ * CONFIG_USBD_HID_IN_BUF_COUNT reports at once, completing them in
+ * order, so a ring slot stays in use from submission until its
+ * completion: tail is the next report to submit, done the next one to
+ * complete, and producers see head - done as the depth. With the legacy
+ * stack the endpoint copies the report, so done always equals tail.
+ *
+ * With CONFIG_HIDRELAY_USB_SOF_SYNC the coalesced slot is only submitted
+ * right after a start-of-frame. The endpoint then holds the motion as of
+ * the start of the frame the host polls it in, instead of the motion as
+ * of whenever the previous transfer completed, up to a frame earlier.
+ */
+#define HID_OUT_QUEUE_LEN	32	/* power of two */
+#define HID_OUT_QUEUE_MASK	(HID_OUT_QUEUE_LEN - 1)
+#define HID_OUT_STACK_SIZE	1024
+#define HID_OUT_PRIORITY	K_PRIO_COOP(9)
+/* An IN transfer not completed within this long is treated as lost */
+#define HID_EP_TIMEOUT_MS	100
 
-#define QT_HID_MAP_SIZE (sizeof(qt_hid_map) / sizeof(qt_to_hid_mapping_t))
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+/* Reports the stack may hold per interface */
+#define HID_EP_INFLIGHT		CONFIG_USBD_HID_IN_BUF_COUNT
+#define HID_EP_INFLIGHT_MASK	(HID_EP_INFLIGHT - 1)
 
+BUILD_ASSERT(IS_POWER_OF_TWO(HID_EP_INFLIGHT),
+	     "CONFIG_USBD_HID_IN_BUF_COUNT must be a power of two");
+#endif
 
-static K_SEM_DEFINE(usb_sem, 1, 1);	/* starts off "available" */
-static void in_ready_cb(const struct device *dev)
+struct hid_out_report {
+	uint8_t len;
+	uint8_t data[HID_OUT_REPORT_MAX];
+	struct lat_stamp lat;
+};
+
+struct hid_ep {
+	const struct device *dev;
+
+	struct hid_out_report queue[HID_OUT_QUEUE_LEN];
+	atomic_t head;
+	atomic_t tail;
+	atomic_t done;
+	struct k_spinlock prod_lock;
+
+	/* Coalesced report, sent once the ring is empty (prod_lock) */
+	struct hid_out_report latest;
+	bool latest_pending;
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+	/* Reports handed to the stack, oldest first */
+	struct hid_out_report *xfer[HID_EP_INFLIGHT];
+	atomic_t xfer_head;	/* writer thread */
+	atomic_t xfer_tail;	/* completion callback */
+	/* Coalesced report while the stack holds it */
+	struct hid_out_report motion;
+	atomic_t motion_busy;
+	/* Interface configured by the host */
+	atomic_t ready;
+#else
+	/* Set while an IN transfer is outstanding, cleared on completion */
+	atomic_t busy;
+	uint32_t busy_since;
+	struct lat_stamp inflight;
+#endif
+
+	uint32_t high_water;
+	atomic_t dropped;
+	atomic_t sent;
+	atomic_t coalesced;
+};
+
+/* Service order is priority order: keystrokes go out before motion */
+static struct hid_ep hid_eps[HID_IFACE_COUNT];
+
+static K_SEM_DEFINE(out_work_sem, 0, 1);
+
+/*
+ * Start-of-frame handshake: the writer sets sof_wait while coalesced
+ * motion is held back, the next SOF turns it into sof_seen.
+ */
+static atomic_t sof_wait;
+static atomic_t sof_seen;
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+/* Set between a bus suspend and the following resume */
+static atomic_t hid_suspended;
+#endif
+
+/* Registered hid_out_space_wait entries, appended at init only */
+static sys_slist_t space_waiters = SYS_SLIST_STATIC_INIT(&space_waiters);
+
+#if !defined(CONFIG_HIDRELAY_USBD_NEXT)
+static void hid_ep_complete(enum hid_iface iface)
+{
+	struct hid_ep *ep = &hid_eps[iface];
+
+	LOG_DBG("IN complete, iface %d", iface);
+	if (ep->inflight.valid) {
+		latency_complete(&ep->inflight);
+		ep->inflight.valid = 0;
+	}
+	atomic_clear(&ep->busy);
+	k_sem_give(&out_work_sem);
+}
+
+static void kbd_in_ready_cb(const struct device *dev)
 {
 	ARG_UNUSED(dev);
-    printk("in_ready_cb\n");
-	k_sem_give(&usb_sem);
+	hid_ep_complete(HID_IFACE_KBD);
 }
 
-// Function to get HID key code and modifier from Qt key code
-bool get_hid_key(uint32_t qt_key, uint8_t *hid_key, uint8_t *modifier) {
-    for (size_t i = 0; i < QT_HID_MAP_SIZE; i++) {
-        if (qt_hid_map[i].qt_key == qt_key) {
-            *hid_key = qt_hid_map[i].hid_key;
-            *modifier = qt_hid_map[i].modifier;
-            return true;
-        }
-    }
-    return false; // Key not found
+#if !defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+static void mouse_in_ready_cb(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+	hid_ep_complete(HID_IFACE_MOUSE);
+}
+#endif
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+static void mouse_rel_in_ready_cb(const struct device *dev)
+{
+	ARG_UNUSED(dev);
+	hid_ep_complete(HID_IFACE_MOUSE_REL);
+}
+#endif
+#else /* CONFIG_HIDRELAY_USBD_NEXT */
+/* The stack completes IN reports in submission order */
+static void hid_ep_complete(struct hid_ep *ep)
+{
+	atomic_val_t n = atomic_get(&ep->xfer_tail);
+	struct hid_out_report *rep;
+
+	if (n == atomic_get(&ep->xfer_head)) {
+		return;
+	}
+	rep = ep->xfer[n & HID_EP_INFLIGHT_MASK];
+	if (rep->lat.valid) {
+		latency_complete(&rep->lat);
+	}
+	atomic_set(&ep->xfer_tail, n + 1);
+
+	/* Only now may the producer reuse the buffer */
+	if (rep == &ep->motion) {
+		atomic_clear(&ep->motion_busy);
+	} else {
+		atomic_inc(&ep->done);
+	}
+	k_sem_give(&out_work_sem);
+}
+#endif /* !CONFIG_HIDRELAY_USBD_NEXT */
+
+/* Caller holds ep->prod_lock */
+static int hid_out_enqueue_locked(struct hid_ep *ep, const uint8_t *data,
+				  uint8_t len)
+{
+	atomic_val_t head = atomic_get(&ep->head);
+	uint32_t depth = (uint32_t)(head - atomic_get(&ep->done));
+	struct hid_out_report *rep;
+
+	if (depth >= HID_OUT_QUEUE_LEN) {
+		atomic_inc(&ep->dropped);
+		LOG_DBG("Queue full, iface %d", (int)(ep - hid_eps));
+		return -ENOMEM;
+	}
+
+	rep = &ep->queue[head & HID_OUT_QUEUE_MASK];
+	rep->len = len;
+	memcpy(rep->data, data, len);
+	latency_capture(&rep->lat);
+
+	/* Publish the slot only after it is fully written */
+	atomic_set(&ep->head, head + 1);
+
+	/*
+	 * The queued report carries a newer state than any coalesced one
+	 * of the same kind; on the composite interface, motion survives a
+	 * keyboard report.
+	 */
+	if (HID_ID_LEN == 0 || ep->latest.data[0] == data[0]) {
+		ep->latest_pending = false;
+	}
+
+	if (depth + 1 > ep->high_water) {
+		ep->high_water = depth + 1;
+	}
+	return 0;
+}
+
+static int hid_out_enqueue(enum hid_iface iface, const uint8_t *data,
+			   uint8_t len)
+{
+	struct hid_ep *ep = &hid_eps[iface];
+	k_spinlock_key_t key = k_spin_lock(&ep->prod_lock);
+	int err = hid_out_enqueue_locked(ep, data, len);
+
+	k_spin_unlock(&ep->prod_lock, key);
+
+	if (err == 0) {
+		k_sem_give(&out_work_sem);
+	}
+	return err;
+}
+
+/* Caller holds ep->prod_lock */
+static void hid_out_coalesce_locked(struct hid_ep *ep, const uint8_t *data,
+				    uint8_t len)
+{
+	if (ep->latest_pending) {
+		atomic_inc(&ep->coalesced);
+	}
+	ep->latest.len = len;
+	memcpy(ep->latest.data, data, len);
+	latency_capture(&ep->latest.lat);
+	ep->latest_pending = true;
+}
+
+/*
+ * Take the coalesced report, but only once the ring has drained so it
+ * can never overtake an older queued transition.
+ */
+static bool hid_out_take_latest(struct hid_ep *ep, struct hid_out_report *out)
+{
+	k_spinlock_key_t key = k_spin_lock(&ep->prod_lock);
+	bool taken = false;
+
+	if (ep->latest_pending &&
+	    atomic_get(&ep->tail) == atomic_get(&ep->head)) {
+		*out = ep->latest;
+		ep->latest_pending = false;
+		taken = true;
+	}
+	k_spin_unlock(&ep->prod_lock, key);
+	return taken;
+}
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+/* Add the motion of relative report @p src to @p dst, clamped */
+static void hid_rel_add_motion(uint8_t *dst, const uint8_t *src)
+{
+	for (int i = 1; i <= 3; i += 2) {
+		int32_t v = (int16_t)(dst[i] | (dst[i + 1] << 8)) +
+			    (int16_t)(src[i] | (src[i + 1] << 8));
+
+		v = CLAMP(v, -32767, 32767);
+		dst[i] = (uint8_t)(v & 0xFF);
+		dst[i + 1] = (uint8_t)((uint16_t)v >> 8);
+	}
+}
+#endif
+
+/*
+ * Give back a report from hid_out_take_latest() the endpoint refused,
+ * so the final position is not lost. A newer state coalesced or queued
+ * since then wins; relative motion is added to it instead.
+ */
+static void hid_out_return_latest(struct hid_ep *ep,
+				  const struct hid_out_report *rep)
+{
+	k_spinlock_key_t key = k_spin_lock(&ep->prod_lock);
+	atomic_val_t head = atomic_get(&ep->head);
+	bool newer = ep->latest_pending;
+
+	/* The ring was empty at take time, whatever is in it came later */
+	for (atomic_val_t i = atomic_get(&ep->tail); !newer && i != head; i++) {
+		newer = HID_ID_LEN == 0 ||
+			ep->queue[i & HID_OUT_QUEUE_MASK].data[0] == rep->data[0];
+	}
+
+	if (!newer) {
+		ep->latest = *rep;
+		ep->latest_pending = true;
+	}
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+	else if (ep == &hid_eps[HID_IFACE_MOUSE_REL]) {
+		if (!ep->latest_pending) {
+			/* Motion goes out with the newest queued buttons */
+			ep->latest = *rep;
+			ep->latest.data[0] =
+				ep->queue[(head - 1) & HID_OUT_QUEUE_MASK].data[0];
+			ep->latest_pending = true;
+		} else {
+			hid_rel_add_motion(ep->latest.data, rep->data);
+		}
+	}
+#endif
+	k_spin_unlock(&ep->prod_lock, key);
+}
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+static int hid_ep_submit(struct hid_ep *ep, struct hid_out_report *rep)
+{
+	atomic_val_t n = atomic_get(&ep->xfer_head);
+	int err;
+
+	latency_mark(&rep->lat, LAT_SUBMITTED);
+
+	/* Recorded first, the completion can run before submit returns */
+	ep->xfer[n & HID_EP_INFLIGHT_MASK] = rep;
+	atomic_set(&ep->xfer_head, n + 1);
+
+	err = hid_device_submit_report(ep->dev, rep->len, rep->data);
+	if (err == 0) {
+		atomic_inc(&ep->sent);
+	} else {
+		atomic_set(&ep->xfer_head, n);
+	}
+	return err;
+}
+
+/*
+ * Keep up to HID_EP_INFLIGHT reports with the stack: queued ones in
+ * order, then the coalesced one once the ring has drained. A report
+ * the stack refuses stays queued and is retried on the next wakeup
+ * (completion, new input or the interface coming back).
+ * @p frame is set on the first pass after a start-of-frame.
+ */
+static void hid_ep_service(struct hid_ep *ep, bool frame)
+{
+	while (atomic_get(&ep->ready) && !atomic_get(&hid_suspended) &&
+	       atomic_get(&ep->xfer_head) - atomic_get(&ep->xfer_tail) <
+	       HID_EP_INFLIGHT) {
+		atomic_val_t tail = atomic_get(&ep->tail);
+
+		if (tail != atomic_get(&ep->head)) {
+			if (hid_ep_submit(ep,
+				&ep->queue[tail & HID_OUT_QUEUE_MASK]) != 0) {
+				return;
+			}
+			atomic_set(&ep->tail, tail + 1);
+			continue;
+		}
+
+		/* One coalesced report at a time, it has a single buffer */
+		if (atomic_get(&ep->motion_busy)) {
+			return;
+		}
+		if (IS_ENABLED(CONFIG_HIDRELAY_USB_SOF_SYNC) && !frame) {
+			if (ep->latest_pending) {
+				atomic_set(&sof_wait, 1);
+			}
+			return;
+		}
+		if (hid_out_take_latest(ep, &ep->motion)) {
+			atomic_set(&ep->motion_busy, 1);
+			if (hid_ep_submit(ep, &ep->motion) != 0) {
+				hid_out_return_latest(ep, &ep->motion);
+				atomic_clear(&ep->motion_busy);
+			}
+		}
+		return;
+	}
+}
+#else
+static int hid_ep_submit(struct hid_ep *ep, struct hid_out_report *rep)
+{
+	int err;
+
+	ep->busy_since = k_uptime_get_32();
+	atomic_set(&ep->busy, 1);
+
+	latency_mark(&rep->lat, LAT_SUBMITTED);
+	ep->inflight = rep->lat;
+
+	err = hid_int_ep_write(ep->dev, rep->data, rep->len, NULL);
+	if (err == 0) {
+		atomic_inc(&ep->sent);
+	} else {
+		ep->inflight.valid = 0;
+		if (err != -EAGAIN) {
+			/* The report is released unsent, count it as dropped */
+			atomic_clear(&ep->busy);
+			atomic_inc(&ep->dropped);
+			LOG_WRN("IN write failed (err %d), iface %d", err,
+				(int)(ep - hid_eps));
+		}
+	}
+	return err;
+}
+
+/*
+ * Submit the next queued (or coalesced) report if the endpoint is free.
+ * @p frame is set on the first pass after a start-of-frame.
+ */
+static void hid_ep_service(struct hid_ep *ep, bool frame)
+{
+	struct hid_out_report *rep;
+	struct hid_out_report latest;
+	atomic_val_t tail;
+
+	if (atomic_get(&ep->busy)) {
+		if (k_uptime_get_32() - ep->busy_since < HID_EP_TIMEOUT_MS) {
+			return;
+		}
+		/* Host stopped polling or the completion got lost */
+		atomic_clear(&ep->busy);
+	}
+
+	tail = atomic_get(&ep->tail);
+	if (tail == atomic_get(&ep->head)) {
+		if (IS_ENABLED(CONFIG_HIDRELAY_USB_SOF_SYNC) && !frame) {
+			/* Unlocked peek; a new coalesce wakes the writer anyway */
+			if (ep->latest_pending) {
+				atomic_set(&sof_wait, 1);
+			}
+			return;
+		}
+		if (hid_out_take_latest(ep, &latest) &&
+		    hid_ep_submit(ep, &latest) == -EAGAIN) {
+			/* Retried on completion, like a queued report */
+			hid_out_return_latest(ep, &latest);
+		}
+		return;
+	}
+	rep = &ep->queue[tail & HID_OUT_QUEUE_MASK];
+
+	if (hid_ep_submit(ep, rep) == -EAGAIN) {
+		/* Endpoint still owned by an earlier transfer, retry on completion */
+		return;
+	}
+
+	/* Endpoint buffer holds its own copy, release the slot */
+	atomic_set(&ep->tail, tail + 1);
+	atomic_set(&ep->done, tail + 1);
+}
+
+static bool hid_ep_any_busy(void)
+{
+	for (int i = 0; i < HID_IFACE_COUNT; i++) {
+		if (atomic_get(&hid_eps[i].busy)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif
+
+static void hid_out_thread(void *p1, void *p2, void *p3)
+{
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (true) {
+		struct hid_out_space_wait *w;
+		bool frame = atomic_clear(&sof_seen);
+
+		for (int i = 0; i < HID_IFACE_COUNT; i++) {
+			hid_ep_service(&hid_eps[i], frame);
+		}
+
+		SYS_SLIST_FOR_EACH_CONTAINER(&space_waiters, w, node) {
+			atomic_val_t want = atomic_get(&w->want);
+
+			if (want && hid_out_credits() >= (uint32_t)want &&
+			    atomic_cas(&w->want, want, 0)) {
+				w->cb();
+			}
+		}
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+		/* The stack reports every completion, nothing to poll for */
+		k_sem_take(&out_work_sem, K_FOREVER);
+#else
+		/* Only poll for lost completions while something is in flight */
+		k_sem_take(&out_work_sem, hid_ep_any_busy() ?
+			   K_MSEC(HID_EP_TIMEOUT_MS) : K_FOREVER);
+#endif
+	}
+}
+
+K_THREAD_DEFINE(hid_out_tid, HID_OUT_STACK_SIZE, hid_out_thread,
+		NULL, NULL, NULL, HID_OUT_PRIORITY, 0, 0);
+
+void hid_out_get_stats(enum hid_iface iface, struct hid_out_stats *stats)
+{
+	struct hid_ep *ep = &hid_eps[iface];
+
+	stats->depth = (uint32_t)(atomic_get(&ep->head) - atomic_get(&ep->done));
+	stats->high_water = ep->high_water;
+	stats->dropped = (uint32_t)atomic_get(&ep->dropped);
+	stats->sent = (uint32_t)atomic_get(&ep->sent);
+	stats->coalesced = (uint32_t)atomic_get(&ep->coalesced);
+}
+
+uint32_t hid_out_credits(void)
+{
+	uint32_t credits = HID_OUT_QUEUE_LEN;
+
+	for (int i = 0; i < HID_IFACE_COUNT; i++) {
+		struct hid_ep *ep = &hid_eps[i];
+		uint32_t depth = (uint32_t)(atomic_get(&ep->head) -
+					    atomic_get(&ep->done));
+
+		credits = MIN(credits, HID_OUT_QUEUE_LEN - depth);
+	}
+	return credits;
+}
+
+void hid_out_sof(void)
+{
+	if (atomic_cas(&sof_wait, 1, 0)) {
+		atomic_set(&sof_seen, 1);
+		k_sem_give(&out_work_sem);
+	}
+}
+
+void hid_out_space_wait_init(struct hid_out_space_wait *w,
+			     hid_out_space_cb_t cb)
+{
+	w->cb = cb;
+	atomic_clear(&w->want);
+	sys_slist_append(&space_waiters, &w->node);
 }
 
-const struct device *hid0_dev;
-const struct device *hid1_dev;
+void hid_out_space_wait_arm(struct hid_out_space_wait *w, uint32_t credits)
+{
+	atomic_set(&w->want, credits);
+
+	/* The queues may already have drained, let the writer check */
+	k_sem_give(&out_work_sem);
+}
+
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+/*
+ * Keyboard, absolute mouse and consumer control on one interface. The
+ * collections are the same as on the separate interfaces, each tagged
+ * with a report ID. Without a boot subclass the keyboard always uses
+ * its report-protocol layout.
+ */
+static const uint8_t hid_composite_report_desc[] = {
+    0x05, 0x01,        /* Usage Page (Generic Desktop) */
+    0x09, 0x06,        /* Usage (Keyboard) */
+    0xa1, 0x01,        /* Collection (Application) */
+      0x85, HID_REPORT_ID_KBD, /* Report ID */
+
+      /* Modifiers */
+      0x05, 0x07,      /*   Usage Page (Keyboard) */
+      0x19, 0xe0,      /*   Usage Minimum (Left Control) */
+      0x29, 0xe7,      /*   Usage Maximum (Right GUI) */
+      0x15, 0x00,      /*   Logical Minimum (0) */
+      0x25, 0x01,      /*   Logical Maximum (1) */
+      0x75, 0x01,      /*   Report Size (1) */
+      0x95, 0x08,      /*   Report Count (8) */
+      0x81, 0x02,      /*   Input (Data,Var,Abs) */
+
+#if !defined(CONFIG_HIDRELAY_KBD_NKRO)
+      /* Reserved byte */
+      0x95, 0x01,      /*   Report Count (1) */
+      0x75, 0x08,      /*   Report Size (8) */
+      0x81, 0x01,      /*   Input (Cnst,Arr,Abs) */
+#endif
+
+      /* LEDs */
+      0x05, 0x08,      /*   Usage Page (LEDs) */
+      0x19, 0x01,      /*   Usage Minimum (Num Lock) */
+      0x29, 0x05,      /*   Usage Maximum (Kana) */
+      0x95, 0x05,      /*   Report Count (5) */
+      0x75, 0x01,      /*   Report Size (1) */
+      0x91, 0x02,      /*   Output (Data,Var,Abs) */
+      0x95, 0x01,      /*   Report Count (1) */
+      0x75, 0x03,      /*   Report Size (3) */
+      0x91, 0x03,      /*   Output (Cnst,Var,Abs) */
+
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+      /* Key bitmap */
+      0x05, 0x07,      /*   Usage Page (Keyboard) */
+      0x19, 0x00,      /*   Usage Minimum (0) */
+      0x29, HID_NKRO_KEY_USAGES - 1, /* Usage Maximum */
+      0x15, 0x00,      /*   Logical Minimum (0) */
+      0x25, 0x01,      /*   Logical Maximum (1) */
+      0x75, 0x01,      /*   Report Size (1) */
+      0x95, HID_NKRO_KEY_USAGES, /* Report Count */
+      0x81, 0x02,      /*   Input (Data,Var,Abs) */
+#else
+      /* Six key slots */
+      0x95, 0x06,      /*   Report Count (6) */
+      0x75, 0x08,      /*   Report Size (8) */
+      0x15, 0x00,      /*   Logical Minimum (0) */
+      0x25, 0x65,      /*   Logical Maximum (101) */
+      0x05, 0x07,      /*   Usage Page (Keyboard) */
+      0x19, 0x00,      /*   Usage Minimum (0) */
+      0x29, 0x65,      /*   Usage Maximum (101) */
+      0x81, 0x00,      /*   Input (Data,Arr,Abs) */
+#endif
+    0xc0,              /* End Collection */
+
+    0x05, 0x01,        /* Usage Page (Generic Desktop) */
+    0x09, 0x02,        /* Usage (Mouse) */
+    0xa1, 0x01,        /* Collection (Application) */
+      0x85, HID_REPORT_ID_MOUSE, /* Report ID */
+      0x09, 0x01,      /*   Usage (Pointer) */
+      0xa1, 0x00,      /*   Collection (Physical) */
 
+        /* Buttons (Left, Right, Middle) */
+        0x05, 0x09,    /*     Usage Page (Button) */
+        0x19, 0x01,    /*     Usage Minimum (Button 1) */
+        0x29, 0x03,    /*     Usage Maximum (Button 3) */
+        0x15, 0x00,    /*     Logical Minimum (0) */
+        0x25, 0x01,    /*     Logical Maximum (1) */
+        0x95, 0x03,    /*     Report Count (3 buttons) */
+        0x75, 0x01,    /*     Report Size (1 bit) */
+        0x81, 0x02,    /*     Input (Data,Var,Abs) */
+
+        0x95, 0x01,
+        0x75, 0x05,
+        0x81, 0x03,    /*     Input (Cnst,Var,Abs) */
+
+        /* X, Y Absolute */
+        0x05, 0x01,    /*     Usage Page (Generic Desktop) */
+        0x09, 0x30,    /*     Usage (X) */
+        0x09, 0x31,    /*     Usage (Y) */
+        0x15, 0x00,    /*     Logical Min (0) */
+        0x26, 0xFF, 0x7F, /*  Logical Max (32767) */
+        0x75, 0x10,    /*     Report Size (16 bits) */
+        0x95, 0x02,    /*     Report Count (2) */
+        0x81, 0x02,    /*     Input (Data,Var,Abs) */
+
+        /* Wheel */
+        0x09, 0x38,    /*     Usage (Wheel) */
+        0x15, 0x81,    /*     Logical Minimum (-127) */
+        0x25, 0x7F,    /*     Logical Maximum (127) */
+        0x75, 0x08,    /*     Report Size (8 bit) */
+        0x95, 0x01,    /*     Report Count (1) */
+        0x81, 0x06,    /*     Input (Data,Var,Rel) */
+
+      0xc0,            /*   End Collection (Physical) */
+    0xc0,              /* End Collection (Application) */
+
+    0x05, 0x0c,        /* Usage Page (Consumer) */
+    0x09, 0x01,        /* Usage (Consumer Control) */
+    0xa1, 0x01,        /* Collection (Application) */
+      0x85, HID_REPORT_ID_CONSUMER, /* Report ID */
+      0x15, 0x00,      /*   Logical Minimum (0) */
+      0x26, 0xff, 0x03, /*  Logical Maximum (1023) */
+      0x19, 0x00,      /*   Usage Minimum (0) */
+      0x2a, 0xff, 0x03, /*  Usage Maximum (1023) */
+      0x75, 0x10,      /*   Report Size (16) */
+      0x95, 0x01,      /*   Report Count (1) */
+      0x81, 0x00,      /*   Input (Data,Arr,Abs) */
+    0xc0               /* End Collection */
+};
+#elif defined(CONFIG_HIDRELAY_KBD_NKRO)
+/*
+ * Report protocol: modifier bitmap followed by a bitmap of every key
+ * usage, so any number of keys can be down at once. The interface also
+ * advertises the boot subclass; a host that switches to boot protocol
+ * (BIOS, UEFI) gets standard 8-byte 6KRO reports instead.
+ */
+static const uint8_t hid_kbd_report_desc[] = {
+    0x05, 0x01,        /* Usage Page (Generic Desktop) */
+    0x09, 0x06,        /* Usage (Keyboard) */
+    0xa1, 0x01,        /* Collection (Application) */
+
+      /* Modifiers */
+      0x05, 0x07,      /*   Usage Page (Keyboard) */
+      0x19, 0xe0,      /*   Usage Minimum (Left Control) */
+      0x29, 0xe7,      /*   Usage Maximum (Right GUI) */
+      0x15, 0x00,      /*   Logical Minimum (0) */
+      0x25, 0x01,      /*   Logical Maximum (1) */
+      0x75, 0x01,      /*   Report Size (1) */
+      0x95, 0x08,      /*   Report Count (8) */
+      0x81, 0x02,      /*   Input (Data,Var,Abs) */
+
+      /* LEDs */
+      0x05, 0x08,      /*   Usage Page (LEDs) */
+      0x19, 0x01,      /*   Usage Minimum (Num Lock) */
+      0x29, 0x05,      /*   Usage Maximum (Kana) */
+      0x95, 0x05,      /*   Report Count (5) */
+      0x75, 0x01,      /*   Report Size (1) */
+      0x91, 0x02,      /*   Output (Data,Var,Abs) */
+      0x95, 0x01,      /*   Report Count (1) */
+      0x75, 0x03,      /*   Report Size (3) */
+      0x91, 0x03,      /*   Output (Cnst,Var,Abs) */
+
+      /* Key bitmap */
+      0x05, 0x07,      /*   Usage Page (Keyboard) */
+      0x19, 0x00,      /*   Usage Minimum (0) */
+      0x29, HID_NKRO_KEY_USAGES - 1, /* Usage Maximum */
+      0x15, 0x00,      /*   Logical Minimum (0) */
+      0x25, 0x01,      /*   Logical Maximum (1) */
+      0x75, 0x01,      /*   Report Size (1) */
+      0x95, HID_NKRO_KEY_USAGES, /* Report Count */
+      0x81, 0x02,      /*   Input (Data,Var,Abs) */
+
+    0xc0               /* End Collection */
+};
+#else
 static const uint8_t hid_kbd_report_desc[] = HID_KEYBOARD_REPORT_DESC();
+#endif
+
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+/* Set while the host has selected boot protocol */
+static atomic_t kbd_boot_protocol;
+
+static void kbd_protocol_cb(const struct device *dev, uint8_t protocol)
+{
+	ARG_UNUSED(dev);
+	atomic_set(&kbd_boot_protocol, protocol == HID_PROTOCOL_BOOT);
+}
+#endif
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+static struct hid_ep *hid_ep_of(const struct device *dev)
+{
+	for (int i = 0; i < HID_IFACE_COUNT; i++) {
+		if (hid_eps[i].dev == dev) {
+			return &hid_eps[i];
+		}
+	}
+	return NULL;
+}
+
+static void hid_iface_ready_cb(const struct device *dev, const bool ready)
+{
+	struct hid_ep *ep = hid_ep_of(dev);
+
+	if (ep == NULL) {
+		return;
+	}
+	atomic_set(&ep->ready, ready);
+	if (ready) {
+		/* Submit whatever was queued while unconfigured */
+		k_sem_give(&out_work_sem);
+	}
+}
+
+static int hid_get_report_cb(const struct device *dev, const uint8_t type,
+			     const uint8_t id, const uint16_t len,
+			     uint8_t *const buf)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(type);
+	ARG_UNUSED(id);
+	ARG_UNUSED(len);
+	ARG_UNUSED(buf);
+	return -ENOTSUP;
+}
+
+static void hid_input_report_done_cb(const struct device *dev)
+{
+	struct hid_ep *ep = hid_ep_of(dev);
+
+	if (ep != NULL) {
+		hid_ep_complete(ep);
+	}
+}
+
+#if defined(CONFIG_HIDRELAY_USB_SOF_SYNC)
+static void hid_sof_cb(const struct device *dev)
+{
+	/* Every interface sees the frame, act on the first one only */
+	if (dev == hid_eps[0].dev) {
+		hid_out_sof();
+	}
+}
+#endif
+
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+static void kbd_set_protocol_cb(const struct device *dev, const uint8_t proto)
+{
+	kbd_protocol_cb(dev, proto);
+}
+#endif
 
-static const struct hid_ops ops = {
-	.int_in_ready = in_ready_cb,
+static const struct hid_device_ops kbd_ops = {
+	.iface_ready = hid_iface_ready_cb,
+	.get_report = hid_get_report_cb,
+	.input_report_done = hid_input_report_done_cb,
+#if defined(CONFIG_HIDRELAY_USB_SOF_SYNC)
+	.sof = hid_sof_cb,
+#endif
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+	.set_protocol = kbd_set_protocol_cb,
+#endif
 };
 
+static const struct hid_device_ops mouse_ops = {
+	.iface_ready = hid_iface_ready_cb,
+	.get_report = hid_get_report_cb,
+	.input_report_done = hid_input_report_done_cb,
+};
+
+void hid_out_set_suspended(bool suspended)
+{
+	atomic_set(&hid_suspended, suspended);
+	if (!suspended) {
+		k_sem_give(&out_work_sem);
+	}
+}
+
+static bool hid_usbd_register(enum hid_iface iface, const struct device *dev,
+			      const uint8_t *desc, size_t len,
+			      const struct hid_device_ops *ops)
+{
+	int err;
+
+	if (!device_is_ready(dev)) {
+		LOG_ERR("HID device %s is not ready", dev->name);
+		return false;
+	}
+	/* Before registering, the callbacks look the device up */
+	hid_eps[iface].dev = dev;
+
+	err = hid_device_register(dev, desc, len, ops);
+	if (err) {
+		LOG_ERR("Failed to register HID device %s (err %d)",
+			dev->name, err);
+		return false;
+	}
+	return true;
+}
+
+/* Must run before usbd_init(), see usbd_init.c */
 bool hid_keyboard_init(void)
 {
-    
+	if (!hid_usbd_register(HID_IFACE_KBD,
+			       DEVICE_DT_GET(DT_NODELABEL(hid_dev_0)),
+			       hid_kbd_report_desc, sizeof(hid_kbd_report_desc),
+			       &kbd_ops)) {
+		return false;
+	}
+	if (!hid_usbd_register(HID_IFACE_MOUSE,
+			       DEVICE_DT_GET(DT_NODELABEL(hid_dev_1)),
+			       hid_mouse_abs_report_desc,
+			       sizeof(hid_mouse_abs_report_desc), &mouse_ops)) {
+		return false;
+	}
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+	if (!hid_usbd_register(HID_IFACE_MOUSE_REL,
+			       DEVICE_DT_GET(DT_NODELABEL(hid_dev_2)),
+			       hid_mouse_rel_report_desc,
+			       sizeof(hid_mouse_rel_report_desc), &mouse_ops)) {
+		return false;
+	}
+#endif
+	return true;
+}
+#else
+static const struct hid_ops kbd_ops = {
+	.int_in_ready = kbd_in_ready_cb,
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+	.protocol_change = kbd_protocol_cb,
+#endif
+};
+
+#if !defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+static const struct hid_ops mouse_ops = {
+	.int_in_ready = mouse_in_ready_cb,
+};
+#endif
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+static const struct hid_ops mouse_rel_ops = {
+	.int_in_ready = mouse_rel_in_ready_cb,
+};
+#endif
+
+bool hid_keyboard_init(void)
+{
+    const struct device *hid0_dev;
+
 	hid0_dev = device_get_binding("HID_0");
 	if (hid0_dev == NULL) {
-		printk("Cannot get USB HID 0 Device");
+		LOG_ERR("Cannot get USB HID 0 Device");
 		return 0;
 	}
 	/* Initialize HID */
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+	usb_hid_register_device(hid0_dev, hid_composite_report_desc,
+				sizeof(hid_composite_report_desc), &kbd_ops);
+#else
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+	usb_hid_set_proto_code(hid0_dev, HID_BOOT_IFACE_CODE_KEYBOARD);
+#endif
 	usb_hid_register_device(hid0_dev, hid_kbd_report_desc,
-				sizeof(hid_kbd_report_desc), &ops);
+				sizeof(hid_kbd_report_desc), &kbd_ops);
+#endif
 	if(usb_hid_init(hid0_dev))
     {
-        printk("Failed to initialize HID device\n");
+        LOG_ERR("Failed to initialize HID device");
         return false;
     }
+    hid_eps[HID_IFACE_KBD].dev = hid0_dev;
+
+#if !defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+    const struct device *hid1_dev;
 
     hid1_dev = device_get_binding("HID_1");
     if (hid1_dev == NULL) {
-        printk("Cannot get USB HID 1 Device");
+        LOG_ERR("Cannot get USB HID 1 Device");
         return 0;
     }
     usb_hid_register_device(hid1_dev, hid_mouse_abs_report_desc,
-                sizeof(hid_mouse_abs_report_desc), &ops);
+                sizeof(hid_mouse_abs_report_desc), &mouse_ops);
     if(usb_hid_init(hid1_dev))
     {
-        printk("Failed to initialize HID device\n");
+        LOG_ERR("Failed to initialize HID device");
+        return false;
+    }
+    hid_eps[HID_IFACE_MOUSE].dev = hid1_dev;
+#endif
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+    const struct device *hid2_dev = device_get_binding("HID_2");
+
+    if (hid2_dev == NULL) {
+        LOG_ERR("Cannot get USB HID 2 Device");
+        return false;
+    }
+    usb_hid_register_device(hid2_dev, hid_mouse_rel_report_desc,
+                sizeof(hid_mouse_rel_report_desc), &mouse_rel_ops);
+    if (usb_hid_init(hid2_dev)) {
+        LOG_ERR("Failed to initialize HID device");
         return false;
     }
+    hid_eps[HID_IFACE_MOUSE_REL].dev = hid2_dev;
+#endif
 
     return true;
 }
+#endif /* CONFIG_HIDRELAY_USBD_NEXT */
+
+/*
+ * Reports are built at buf + HID_ID_LEN; on the composite interface the
+ * byte in front of them carries the report ID.
+ */
+static inline void hid_set_report_id(uint8_t *buf, uint8_t id)
+{
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+	buf[0] = id;
+#else
+	ARG_UNUSED(buf);
+	ARG_UNUSED(id);
+#endif
+}
+
+/* Boot-protocol report: modifiers, reserved, up to six usages */
+static void hid_kbd_boot_report(uint8_t modifiers, const uint8_t *bitmap,
+				uint8_t *report)
+{
+	int n = 0;
+
+	memset(report, 0, HID_REPORT_SIZE_K);
+	report[0] = modifiers;
+
+	for (int i = 0; i < HID_KBD_BITMAP_SIZE && n < 6; i++) {
+		uint8_t bits = bitmap[i];
+
+		while (bits && n < 6) {
+			int bit = __builtin_ctz(bits);
+
+			report[2 + n++] = (uint8_t)(i * 8 + bit);
+			bits &= bits - 1;
+		}
+	}
+}
+
+bool hid_keyboard_send_keys(uint8_t modifiers, const uint8_t *bitmap)
+{
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+    if (!atomic_get(&kbd_boot_protocol)) {
+        uint8_t buf[HID_ID_LEN + HID_REPORT_SIZE_NKRO];
+        uint8_t *report = buf + HID_ID_LEN;
+
+        hid_set_report_id(buf, HID_REPORT_ID_KBD);
+        report[0] = modifiers;
+        memcpy(&report[1], bitmap, HID_REPORT_SIZE_NKRO - 1);
+        return hid_out_enqueue(HID_IFACE_KBD, buf, sizeof(buf)) == 0;
+    }
+#endif
+    uint8_t buf[HID_ID_LEN + HID_REPORT_SIZE_K];
+
+    hid_set_report_id(buf, HID_REPORT_ID_KBD);
+    hid_kbd_boot_report(modifiers, bitmap, buf + HID_ID_LEN);
+    return hid_out_enqueue(HID_IFACE_KBD, buf, sizeof(buf)) == 0;
+}
 
 bool hid_keyboard_send_report(uint8_t *report)
 {
-	k_sem_take(&usb_sem, K_MSEC(100));
-    return hid_int_ep_write(hid0_dev, report, HID_REPORT_SIZE_K, NULL);
+#if defined(CONFIG_HIDRELAY_KBD_NKRO)
+    if (!atomic_get(&kbd_boot_protocol)) {
+        uint8_t bitmap[HID_KBD_BITMAP_SIZE] = {0};
+
+        for (int i = 2; i < HID_REPORT_SIZE_K; i++) {
+            if (report[i] != 0) {
+                bitmap[report[i] >> 3] |= BIT(report[i] & 7);
+            }
+        }
+        return !hid_keyboard_send_keys(report[0], bitmap);
+    }
+#endif
+    uint8_t buf[HID_ID_LEN + HID_REPORT_SIZE_K];
+
+    hid_set_report_id(buf, HID_REPORT_ID_KBD);
+    memcpy(buf + HID_ID_LEN, report, HID_REPORT_SIZE_K);
+    return hid_out_enqueue(HID_IFACE_KBD, buf, sizeof(buf));
 }
 
+/* Button state of the last queued absolute report (mouse prod_lock) */
+static uint8_t mouse_abs_buttons;
+
 bool hid_mouse_abs_send(uint8_t buttons, uint16_t x, uint16_t y, int8_t wheel)
 {
-    uint8_t report[6];
+    uint8_t buf[HID_ID_LEN + HID_REPORT_SIZE_M];
+    uint8_t *report = buf + HID_ID_LEN;
+
+    hid_set_report_id(buf, HID_REPORT_ID_MOUSE);
     report[0] = buttons;        
     report[1] = (uint8_t)(x & 0xFF);
     report[2] = (uint8_t)(x >> 8);
     report[3] = (uint8_t)(y & 0xFF);
     report[4] = (uint8_t)(y >> 8);
     report[5] = (uint8_t)(wheel);
-    k_sem_take(&usb_sem, K_MSEC(100));
-    int err = hid_int_ep_write(hid1_dev, report, sizeof(report), NULL);
+
+    struct hid_ep *ep = &hid_eps[HID_EP_MOUSE];
+    k_spinlock_key_t key = k_spin_lock(&ep->prod_lock);
+    int err = 0;
+
+    if (buttons == mouse_abs_buttons && wheel == 0) {
+        /* Pure motion: only the newest position matters */
+        hid_out_coalesce_locked(ep, buf, sizeof(buf));
+    } else {
+        err = hid_out_enqueue_locked(ep, buf, sizeof(buf));
+        if (err == 0) {
+            mouse_abs_buttons = buttons;
+        }
+    }
+    k_spin_unlock(&ep->prod_lock, key);
+
+    k_sem_give(&out_work_sem);
     return (err == 0);
 }
 
 bool hid_mouse_abs_clear(void)
 {
-    uint8_t report[6] = {0};
-    k_sem_take(&usb_sem, K_MSEC(100));
-    int err = hid_int_ep_write(hid1_dev, report, sizeof(report), NULL);
+    uint8_t buf[HID_ID_LEN + HID_REPORT_SIZE_M] = {0};
+    struct hid_ep *ep = &hid_eps[HID_EP_MOUSE];
+    k_spinlock_key_t key;
+    int err;
+
+    hid_set_report_id(buf, HID_REPORT_ID_MOUSE);
+    key = k_spin_lock(&ep->prod_lock);
+    err = hid_out_enqueue_locked(ep, buf, sizeof(buf));
+
+    if (err == 0) {
+        mouse_abs_buttons = 0;
+    }
+    k_spin_unlock(&ep->prod_lock, key);
+
+    k_sem_give(&out_work_sem);
+    return (err == 0);
+}
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+/* Button state of the last queued relative report (mouse_rel prod_lock) */
+static uint8_t mouse_rel_buttons;
+
+static int16_t clamp_rel(int32_t v)
+{
+    return (int16_t)CLAMP(v, -32767, 32767);
+}
+
+bool hid_mouse_rel_send(uint8_t buttons, int16_t dx, int16_t dy)
+{
+    struct hid_ep *ep = &hid_eps[HID_IFACE_MOUSE_REL];
+    k_spinlock_key_t key = k_spin_lock(&ep->prod_lock);
+    int32_t x = dx;
+    int32_t y = dy;
+    uint8_t report[6];
+    int err = 0;
+
+    /* Fold in motion not yet handed to the endpoint */
+    if (ep->latest_pending) {
+        x += (int16_t)(ep->latest.data[1] | (ep->latest.data[2] << 8));
+        y += (int16_t)(ep->latest.data[3] | (ep->latest.data[4] << 8));
+    }
+
+    report[0] = buttons;
+    report[1] = (uint8_t)(clamp_rel(x) & 0xFF);
+    report[2] = (uint8_t)((uint16_t)clamp_rel(x) >> 8);
+    report[3] = (uint8_t)(clamp_rel(y) & 0xFF);
+    report[4] = (uint8_t)((uint16_t)clamp_rel(y) >> 8);
+    report[5] = 0;
+
+    if (buttons == mouse_rel_buttons) {
+        hid_out_coalesce_locked(ep, report, sizeof(report));
+    } else {
+        err = hid_out_enqueue_locked(ep, report, sizeof(report));
+        if (err == 0) {
+            mouse_rel_buttons = buttons;
+        }
+    }
+    k_spin_unlock(&ep->prod_lock, key);
+
+    k_sem_give(&out_work_sem);
     return (err == 0);
 }
+#endif
 
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+bool hid_consumer_send(uint16_t usage)
+{
+    uint8_t buf[HID_ID_LEN + 2];
+
+    hid_set_report_id(buf, HID_REPORT_ID_CONSUMER);
+    buf[HID_ID_LEN] = (uint8_t)(usage & 0xFF);
+    buf[HID_ID_LEN + 1] = (uint8_t)(usage >> 8);
+    return hid_out_enqueue(HID_IFACE_KBD, buf, sizeof(buf)) == 0;
+}
+#endif
@@ -3,6 +3,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/slist.h>
 
 #define HID_REPORT_SIZE_L 8
 #define HID_REPORT_SIZE_M 4
@@ -10,10 +12,105 @@
 
 bool hid_keyboard_init(void);
 
+/* Bitmap of pressed key usages, bit (usage & 7) of byte (usage >> 3) */
+#define HID_KBD_BITMAP_SIZE 32
+
+/* Boot-format 8-byte report; returns non-zero on failure */
 bool hid_keyboard_send_report(uint8_t *report);
-bool get_hid_key(uint32_t qt_key, uint8_t *hid_key, uint8_t *modifier);
+
+/**
+ * @brief Queue the full keyboard state
+ *
+ * Sent as an NKRO bitmap report when CONFIG_HIDRELAY_KBD_NKRO is set and
+ * the host uses report protocol, otherwise as a 6KRO boot report holding
+ * the first six pressed keys.
+ *
+ * @return true if the report was queued
+ */
+bool hid_keyboard_send_keys(uint8_t modifiers, const uint8_t *bitmap);
 
 bool hid_mouse_abs_send(uint8_t buttons, uint16_t x, uint16_t y, int8_t wheel);
 bool hid_mouse_abs_clear(void);
 
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+bool hid_mouse_rel_send(uint8_t buttons, int16_t dx, int16_t dy);
+#endif
+
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+/* Consumer page usage held down, 0 for none */
+bool hid_consumer_send(uint16_t usage);
+#endif
+
+/* HID interfaces, in the order the USB writer services them */
+enum hid_iface {
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+	HID_IFACE_KBD,		/* HID_0: keyboard, mouse and consumer */
+#else
+	HID_IFACE_KBD,		/* HID_0 */
+	HID_IFACE_MOUSE,	/* HID_1 */
+#endif
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+	HID_IFACE_MOUSE_REL,	/* HID_2 */
+#endif
+	HID_IFACE_COUNT,
+};
+
+/* Per-interface report queue between the input path and the USB writer */
+struct hid_out_stats {
+	uint32_t depth;		/* reports waiting right now */
+	uint32_t high_water;	/* deepest the queue has been */
+	uint32_t dropped;	/* reports rejected because the queue was full */
+	uint32_t sent;		/* reports accepted by the endpoint */
+	uint32_t coalesced;	/* motion reports replaced before being sent */
+};
+
+void hid_out_get_stats(enum hid_iface iface, struct hid_out_stats *stats);
+
+/**
+ * @brief Free report slots, the smallest over all interface queues
+ *
+ * Each key or button transition takes one slot; pointer motion is
+ * coalesced and takes none.
+ */
+uint32_t hid_out_credits(void);
+
+/**
+ * @brief USB start-of-frame, from the device status callback
+ *
+ * With CONFIG_HIDRELAY_USB_SOF_SYNC, coalesced motion waiting for a
+ * frame is submitted now. Safe to call from ISR context.
+ */
+void hid_out_sof(void);
+
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+/**
+ * @brief Bus suspend and resume, from the usbd message callback
+ *
+ * Reports stay queued while suspended and go out in order on resume.
+ */
+void hid_out_set_suspended(bool suspended);
+#endif
+
+typedef void (*hid_out_space_cb_t)(void);
+
+/* Wait for queue space; owned by the caller, see hid_out_space_wait_init() */
+struct hid_out_space_wait {
+	sys_snode_t node;
+	hid_out_space_cb_t cb;
+	atomic_t want;		/* credits to wait for, 0 while disarmed */
+};
+
+/** @brief Register @p w once at init; @p cb runs on the USB writer thread */
+void hid_out_space_wait_init(struct hid_out_space_wait *w,
+			     hid_out_space_cb_t cb);
+
+/**
+ * @brief Call the waiter's callback once hid_out_credits() reaches
+ *        @p credits
+ *
+ * One-shot; re-arming replaces the previous threshold. The callback must
+ * not block.
+ */
+void hid_out_space_wait_arm(struct hid_out_space_wait *w, uint32_t credits);
+
 #endif // HID_KEYBOARD_H
\ No newline at end of file
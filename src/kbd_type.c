@@ -0,0 +1,230 @@
+/*
+ * On-device text typing
+ *
+ * The text buffer is a byte ring with the same producer/consumer split
+ * as the HID report queues: BLE (or any other transport) appends under a
+ * spinlock, the main loop consumes without one.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "kbd_type.h"
+#include "hid_km.h"
+#include "qt_keymap.h"
+
+#define TYPE_BUF_SIZE		CONFIG_HIDRELAY_KBD_TYPE_BUF_SIZE
+#define TYPE_BUF_MASK		(TYPE_BUF_SIZE - 1)
+
+BUILD_ASSERT(IS_POWER_OF_TWO(TYPE_BUF_SIZE),
+	     "CONFIG_HIDRELAY_KBD_TYPE_BUF_SIZE must be a power of two");
+
+/*
+ * Queue slots left for live input while typing, and the level typing
+ * resumes at. Each character takes two slots (press, release).
+ */
+#define TYPE_RESERVE_CREDITS	16
+#define TYPE_RESUME_CREDITS	(TYPE_RESERVE_CREDITS + 8)
+
+static uint8_t type_buf[TYPE_BUF_SIZE];
+static atomic_t type_head;
+static atomic_t type_tail;
+static struct k_spinlock type_prod_lock;
+
+static bool (*type_wake)(void);
+static atomic_t type_scheduled;
+static struct hid_out_space_wait type_space_wait;
+
+/* Release of the last typed character, still to be queued */
+static bool type_release_pending;
+
+static atomic_t type_typed;
+static atomic_t type_unmapped;
+static atomic_t type_dropped;
+
+static void type_kick(void)
+{
+	if (atomic_cas(&type_scheduled, 0, 1) && !type_wake()) {
+		/* Not scheduled after all, let the next append retry */
+		atomic_clear(&type_scheduled);
+	}
+}
+
+void kbd_type_init(bool (*wake)(void))
+{
+	type_wake = wake;
+	hid_out_space_wait_init(&type_space_wait, type_kick);
+}
+
+size_t kbd_type_append(const uint8_t *utf8, size_t len)
+{
+	k_spinlock_key_t key = k_spin_lock(&type_prod_lock);
+	atomic_val_t head = atomic_get(&type_head);
+	size_t used = (size_t)(head - atomic_get(&type_tail));
+	size_t n = MIN(len, TYPE_BUF_SIZE - used);
+	size_t first = MIN(n, TYPE_BUF_SIZE - (size_t)(head & TYPE_BUF_MASK));
+
+	memcpy(&type_buf[head & TYPE_BUF_MASK], utf8, first);
+	memcpy(type_buf, utf8 + first, n - first);
+	atomic_set(&type_head, head + n);
+	k_spin_unlock(&type_prod_lock, key);
+
+	if (n < len) {
+		atomic_add(&type_dropped, len - n);
+	}
+	if (n > 0) {
+		type_kick();
+	}
+	return n;
+}
+
+static inline uint8_t type_byte(atomic_val_t pos)
+{
+	return type_buf[pos & TYPE_BUF_MASK];
+}
+
+/*
+ * Decode the character at @p tail.
+ *
+ * @return bytes it occupies, 0 if it is not complete yet; malformed
+ *         input decodes as U+FFFD one byte at a time
+ */
+static size_t type_decode(atomic_val_t tail, size_t avail, uint32_t *ch)
+{
+	uint8_t b = type_byte(tail);
+	size_t n;
+
+	if (b < 0x80) {
+		*ch = b;
+		return 1;
+	} else if ((b & 0xE0) == 0xC0) {
+		n = 2;
+		*ch = b & 0x1F;
+	} else if ((b & 0xF0) == 0xE0) {
+		n = 3;
+		*ch = b & 0x0F;
+	} else if ((b & 0xF8) == 0xF0) {
+		n = 4;
+		*ch = b & 0x07;
+	} else {
+		*ch = 0xFFFD;
+		return 1;
+	}
+
+	for (size_t i = 1; i < n; i++) {
+		if (i >= avail) {
+			return 0;
+		}
+		b = type_byte(tail + i);
+		if ((b & 0xC0) != 0x80) {
+			*ch = 0xFFFD;
+			return 1;
+		}
+		*ch = (*ch << 6) | (b & 0x3F);
+	}
+	return n;
+}
+
+/* @return false while the keyboard queue has no room for the release */
+static bool type_release(void)
+{
+	static const uint8_t no_keys[HID_KBD_BITMAP_SIZE];
+
+	type_release_pending = !hid_keyboard_send_keys(0, no_keys);
+	return !type_release_pending;
+}
+
+/*
+ * Press, then release. A release that does not fit is retried before
+ * anything else is typed.
+ *
+ * @return false if the press did not fit; the character is not typed
+ */
+static bool type_char(uint8_t hid_key, uint8_t modifier)
+{
+	uint8_t keys[HID_KBD_BITMAP_SIZE] = {0};
+
+	if (hid_key != 0) {
+		keys[hid_key >> 3] |= BIT(hid_key & 7);
+	}
+	if (!hid_keyboard_send_keys(modifier, keys)) {
+		return false;
+	}
+	type_release();
+	return true;
+}
+
+bool kbd_type_service(void)
+{
+	atomic_val_t tail = atomic_get(&type_tail);
+	bool consumed = false;
+
+	/* Appends from here on schedule another pass */
+	atomic_clear(&type_scheduled);
+
+	if (type_release_pending) {
+		if (!type_release()) {
+			hid_out_space_wait_arm(&type_space_wait,
+					       TYPE_RESUME_CREDITS);
+			return false;
+		}
+		consumed = true;
+	}
+
+	while (tail != atomic_get(&type_head)) {
+		size_t avail = (size_t)(atomic_get(&type_head) - tail);
+		uint8_t hid_key, modifier;
+		uint32_t ch;
+		size_t n;
+
+		if (hid_out_credits() < TYPE_RESERVE_CREDITS + 2) {
+			hid_out_space_wait_arm(&type_space_wait,
+					       TYPE_RESUME_CREDITS);
+			break;
+		}
+
+		n = type_decode(tail, avail, &ch);
+		if (n == 0) {
+			/* Rest of the character comes with the next write */
+			break;
+		}
+
+		if (!get_hid_char(ch, &hid_key, &modifier)) {
+			tail += n;
+			atomic_set(&type_tail, tail);
+			consumed = true;
+			atomic_inc(&type_unmapped);
+			continue;
+		}
+		if (!type_char(hid_key, modifier)) {
+			/* Queue full despite the reserve, keep the character */
+			hid_out_space_wait_arm(&type_space_wait,
+					       TYPE_RESUME_CREDITS);
+			break;
+		}
+		tail += n;
+		atomic_set(&type_tail, tail);
+		consumed = true;
+		atomic_inc(&type_typed);
+
+		if (type_release_pending) {
+			hid_out_space_wait_arm(&type_space_wait,
+					       TYPE_RESUME_CREDITS);
+			break;
+		}
+	}
+
+	/* Done only once the last release is queued too */
+	return consumed && !type_release_pending &&
+	       tail == atomic_get(&type_head);
+}
+
+void kbd_type_get_stats(struct kbd_type_stats *stats)
+{
+	stats->typed = (uint32_t)atomic_get(&type_typed);
+	stats->unmapped = (uint32_t)atomic_get(&type_unmapped);
+	stats->dropped = (uint32_t)atomic_get(&type_dropped);
+	stats->pending = (uint32_t)(atomic_get(&type_head) -
+				    atomic_get(&type_tail));
+}
@@ -0,0 +1,54 @@
+/*
+ * On-device text typing
+ *
+ * Text from KT tokens / TEXT records is buffered and typed as one
+ * press report and one release report per character. The engine only
+ * keeps the keyboard queue half full and refills it as the USB writer
+ * frees slots, so typing runs at the host's poll rate and live input
+ * still finds room in the queue.
+ */
+
+#ifndef HIDRELAY_KBD_TYPE_H_
+#define HIDRELAY_KBD_TYPE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+struct kbd_type_stats {
+	uint32_t typed;		/* characters sent */
+	uint32_t unmapped;	/* characters the layout cannot type */
+	uint32_t dropped;	/* bytes rejected because the buffer was full */
+	uint32_t pending;	/* bytes waiting in the buffer */
+};
+
+/**
+ * @brief Set up the engine
+ *
+ * @param wake called (from any context) when kbd_type_service() has work;
+ *             schedules it on the main loop, false if that failed
+ */
+void kbd_type_init(bool (*wake)(void));
+
+/**
+ * @brief Queue UTF-8 text for typing
+ *
+ * A character split across calls is joined up. Text that does not fit
+ * is dropped and counted.
+ *
+ * @return number of bytes accepted
+ */
+size_t kbd_type_append(const uint8_t *utf8, size_t len);
+
+/**
+ * @brief Type as much as the keyboard queue has room for
+ *
+ * Call from the main loop after the wake callback.
+ *
+ * @return true when the buffer has just been emptied
+ */
+bool kbd_type_service(void);
+
+void kbd_type_get_stats(struct kbd_type_stats *stats);
+
+#endif /* HIDRELAY_KBD_TYPE_H_ */
@@ -0,0 +1,147 @@
+/*
+ * Input latency tracing - stage stamps and histograms
+ *
+ * Stamps come from the timing API, which on the nRF52840 reads the DWT
+ * cycle counter (64 MHz); 32-bit deltas cover about 67 s.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/timing/timing.h>
+#include <zephyr/sys/util.h>
+
+#include "latency.h"
+
+/* Consecutive stage pairs, then RX -> COMPLETED */
+#define LAT_INTERVALS		LAT_STAGE_COUNT
+#define LAT_INTERVAL_TOTAL	(LAT_STAGE_COUNT - 1)
+
+static const char *const stage_names[LAT_STAGE_COUNT] = {
+	[LAT_RX] = "rx",
+	[LAT_PARSED] = "parse",
+	[LAT_QUEUED] = "queue",
+	[LAT_SUBMITTED] = "submit",
+	[LAT_COMPLETED] = "done",
+};
+
+static atomic_t hist[LAT_INTERVALS][LAT_HIST_BUCKETS];
+
+/* Stamps of the event being parsed, only valid in the RX thread */
+static struct lat_stamp current;
+static k_tid_t current_owner;
+
+static inline uint32_t lat_now(void)
+{
+	return (uint32_t)timing_counter_get();
+}
+
+static void lat_record(int interval, uint32_t cycles)
+{
+	uint32_t us = (uint32_t)(timing_cycles_to_ns(cycles) / 1000U);
+	int bucket = (us == 0) ? 0 : 32 - __builtin_clz(us);
+
+	atomic_inc(&hist[interval][MIN(bucket, LAT_HIST_BUCKETS - 1)]);
+}
+
+void latency_init(void)
+{
+	timing_init();
+	timing_start();
+}
+
+void latency_rx_begin(void)
+{
+	current.t[LAT_RX] = lat_now();
+	current.valid = BIT(LAT_RX);
+	current_owner = k_current_get();
+}
+
+void latency_rx_end(void)
+{
+	current_owner = NULL;
+	current.valid = 0;
+}
+
+void latency_mark_parsed(void)
+{
+	if (current_owner == k_current_get()) {
+		latency_mark(&current, LAT_PARSED);
+	}
+}
+
+void latency_capture(struct lat_stamp *st)
+{
+	/* Reports built outside the RX path (main loop) start at QUEUED */
+	if (current_owner == k_current_get()) {
+		*st = current;
+	} else {
+		st->valid = 0;
+	}
+	latency_mark(st, LAT_QUEUED);
+}
+
+void latency_mark(struct lat_stamp *st, enum lat_stage stage)
+{
+	st->t[stage] = lat_now();
+	st->valid |= BIT(stage);
+}
+
+void latency_complete(struct lat_stamp *st)
+{
+	latency_mark(st, LAT_COMPLETED);
+
+	for (int i = 0; i < LAT_STAGE_COUNT - 1; i++) {
+		uint8_t both = BIT(i) | BIT(i + 1);
+
+		if ((st->valid & both) == both) {
+			lat_record(i, st->t[i + 1] - st->t[i]);
+		}
+	}
+
+	if (st->valid & BIT(LAT_RX)) {
+		lat_record(LAT_INTERVAL_TOTAL, st->t[LAT_COMPLETED] - st->t[LAT_RX]);
+	}
+}
+
+void latency_reset(void)
+{
+	for (int i = 0; i < LAT_INTERVALS; i++) {
+		for (int b = 0; b < LAT_HIST_BUCKETS; b++) {
+			atomic_clear(&hist[i][b]);
+		}
+	}
+}
+
+int latency_format(char *buf, size_t len)
+{
+	size_t pos = 0;
+
+	for (int i = 0; i < LAT_INTERVALS; i++) {
+		const char *from = stage_names[i == LAT_INTERVAL_TOTAL ? LAT_RX : i];
+		const char *to = stage_names[i == LAT_INTERVAL_TOTAL ?
+					     LAT_COMPLETED : i + 1];
+		int n = snprintk(buf + pos, len - pos, "LH:%s-%s:", from, to);
+
+		if (n < 0 || (size_t)n >= len - pos) {
+			break;
+		}
+		pos += n;
+
+		for (int b = 0; b < LAT_HIST_BUCKETS; b++) {
+			n = snprintk(buf + pos, len - pos, "%s%u",
+				     b ? "," : "",
+				     (uint32_t)atomic_get(&hist[i][b]));
+			if (n < 0 || (size_t)n >= len - pos) {
+				return pos;
+			}
+			pos += n;
+		}
+
+		if (pos + 1 >= len) {
+			break;
+		}
+		buf[pos++] = '\n';
+		buf[pos] = '\0';
+	}
+
+	return pos;
+}
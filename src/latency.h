@@ -0,0 +1,92 @@
+/*
+ * Input latency tracing
+ *
+ * Every input event is stamped as it moves through the relay:
+ *
+ *   RX         BLE write or CDC ACM chunk entered the input core
+ *   PARSED     token/record decoded into a struct relay_input
+ *   QUEUED     HID report placed in its interface queue
+ *   SUBMITTED  hid_int_ep_write() called for the report
+ *   COMPLETED  host picked the report up (IN ready callback)
+ *
+ * Stage-to-stage deltas are accumulated into log2 microsecond histograms.
+ * With CONFIG_HIDRELAY_LATENCY_TRACE disabled every call compiles away.
+ */
+
+#ifndef HIDRELAY_LATENCY_H
+#define HIDRELAY_LATENCY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+enum lat_stage {
+	LAT_RX,
+	LAT_PARSED,
+	LAT_QUEUED,
+	LAT_SUBMITTED,
+	LAT_COMPLETED,
+	LAT_STAGE_COUNT,
+};
+
+/* Bucket 0 is < 1 us, bucket i is [2^(i-1), 2^i) us, the last is open */
+#define LAT_HIST_BUCKETS 20
+
+#if defined(CONFIG_HIDRELAY_LATENCY_TRACE)
+
+struct lat_stamp {
+	uint32_t t[LAT_STAGE_COUNT];
+	uint8_t valid;		/* bit per stage */
+};
+
+void latency_init(void);
+
+/* Bracket one GATT write; stamps apply to events parsed in between */
+void latency_rx_begin(void);
+void latency_rx_end(void);
+void latency_mark_parsed(void);
+
+/* Copy the current event's stamps into @p st and stamp QUEUED */
+void latency_capture(struct lat_stamp *st);
+void latency_mark(struct lat_stamp *st, enum lat_stage stage);
+
+/* Stamp COMPLETED and add the event to the histograms */
+void latency_complete(struct lat_stamp *st);
+
+void latency_reset(void);
+
+/**
+ * @brief Render the histograms as text, one line per interval:
+ *        "LH:<from>-<to>:<n0>,<n1>,...\n"
+ *
+ * @return number of characters written
+ */
+int latency_format(char *buf, size_t len);
+
+#else
+
+struct lat_stamp {
+	uint8_t valid;
+};
+
+static inline void latency_init(void) {}
+static inline void latency_rx_begin(void) {}
+static inline void latency_rx_end(void) {}
+static inline void latency_mark_parsed(void) {}
+static inline void latency_capture(struct lat_stamp *st) { st->valid = 0; }
+static inline void latency_mark(struct lat_stamp *st, enum lat_stage stage)
+{
+	(void)st;
+	(void)stage;
+}
+static inline void latency_complete(struct lat_stamp *st) { (void)st; }
+static inline void latency_reset(void) {}
+static inline int latency_format(char *buf, size_t len)
+{
+	(void)buf;
+	(void)len;
+	return 0;
+}
+
+#endif /* CONFIG_HIDRELAY_LATENCY_TRACE */
+
+#endif /* HIDRELAY_LATENCY_H */
@@ -8,19 +8,33 @@
 #include <zephyr/drivers/gpio.h>
 #include <zephyr/drivers/pwm.h>
 #include <zephyr/drivers/uart.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/logging/log_ctrl.h>
 #include <string.h>
 
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+#include <zephyr/usb/class/hid.h>
+#include "usbd_init.h"
+#else
 #include <zephyr/usb/usb_device.h>
 #include <zephyr/usb/class/usb_hid.h>
 #include <zephyr/usb/class/usb_cdc.h>
+#endif
 
 #include "hid_km.h"
 
 #include <zephyr/bluetooth/bluetooth.h>
 
 #include "ble_hidrelay.h"
+#include "ble_link.h"
+#include "relay_core.h"
+#include "kbd_type.h"
+#include "latency.h"
+#include "cdc_link.h"
 #include <math.h>
 
+LOG_MODULE_REGISTER(main, CONFIG_HIDRELAY_INPUT_LOG_LEVEL);
+
 #define DEVICE_NAME		CONFIG_BT_DEVICE_NAME
 #define DEVICE_NAME_LEN		(sizeof(DEVICE_NAME) - 1)
 
@@ -47,6 +61,24 @@ static const struct gpio_dt_spec sw0_gpio = GPIO_DT_SPEC_GET(SW0_NODE, gpios);
 
 K_FIFO_DEFINE(evt_fifo);
 
+/*
+ * Main loop wakeup sources. The loop sleeps in k_event_wait() until one
+ * of these is posted; nothing runs periodically while the dongle is idle.
+ */
+#define MAIN_EVT_FIFO		BIT(0)	/* app event queued on evt_fifo */
+#define MAIN_EVT_CONN		BIT(1)	/* BLE link state changed */
+#define MAIN_EVT_LED_FADE	BIT(2)	/* next step of the blue fade */
+#define MAIN_EVT_LED_ERR	BIT(3)	/* red error LED changed state */
+#define MAIN_EVT_CREDITS	BIT(4)	/* flow-control state to notify */
+#define MAIN_EVT_CDC_RX		BIT(5)	/* wired input waiting in cdc_link */
+#define MAIN_EVT_SUBSCRIBED	BIT(6)	/* a central enabled TX notify */
+#define MAIN_EVT_ALL		(MAIN_EVT_FIFO | MAIN_EVT_CONN | \
+				 MAIN_EVT_LED_FADE | MAIN_EVT_LED_ERR | \
+				 MAIN_EVT_CREDITS | MAIN_EVT_CDC_RX | \
+				 MAIN_EVT_SUBSCRIBED)
+
+K_EVENT_DEFINE(main_events);
+
 enum evt_t {
 	GPIO_BUTTON_0	= 0x00,
 	LED_SIGNAL_0	= 0x01,
@@ -61,6 +93,8 @@ enum evt_t {
 	HID_MOUSE_CLEAR	= 0x0A,
 	HID_KBD_CLEAR	= 0x0B,
 	HID_KBD_STRING	= 0x0C,
+	LATENCY_REPORT	= 0x0D,
+	LINK_REPORT	= 0x0E,
 };
 
 struct app_evt_t {
@@ -68,21 +102,32 @@ struct app_evt_t {
 	enum evt_t event_type;
 };
 
-#define FIFO_ELEM_MIN_SZ        sizeof(struct app_evt_t)
-#define FIFO_ELEM_MAX_SZ        sizeof(struct app_evt_t)
+/*
+ * Event elements come from a fixed-block slab: allocation is O(1), ISR
+ * safe and cannot fragment. When every block is in use the newest event
+ * is dropped (app_evt_alloc() returns NULL) and counted; events already
+ * queued are never discarded.
+ */
+#define FIFO_ELEM_SZ            sizeof(struct app_evt_t)
 #define FIFO_ELEM_COUNT         255
 #define FIFO_ELEM_ALIGN         sizeof(unsigned int)
 
-K_HEAP_DEFINE(event_elem_pool, FIFO_ELEM_MAX_SZ * FIFO_ELEM_COUNT + 256);
+BUILD_ASSERT(FIFO_ELEM_SZ % FIFO_ELEM_ALIGN == 0);
+
+K_MEM_SLAB_DEFINE_STATIC(event_elem_slab, FIFO_ELEM_SZ, FIFO_ELEM_COUNT,
+			 FIFO_ELEM_ALIGN);
+
+static atomic_t app_evt_alloc_failures;
 
 static inline void app_evt_free(struct app_evt_t *ev)
 {
-	k_heap_free(&event_elem_pool, ev);
+	k_mem_slab_free(&event_elem_slab, ev);
 }
 
 static inline void app_evt_put(struct app_evt_t *ev)
 {
 	k_fifo_put(&evt_fifo, ev);
+	k_event_post(&main_events, MAIN_EVT_FIFO);
 }
 
 static inline struct app_evt_t *app_evt_get(void)
@@ -90,48 +135,34 @@ static inline struct app_evt_t *app_evt_get(void)
 	return k_fifo_get(&evt_fifo, K_NO_WAIT);
 }
 
-static inline void app_evt_flush(void)
+static inline struct app_evt_t *app_evt_alloc(void)
 {
-	struct app_evt_t *ev;
+	void *block;
 
-	do {
-		ev = app_evt_get();
-		if (ev) {
-			app_evt_free(ev);
-		}
-	} while (ev != NULL);
+	if (k_mem_slab_alloc(&event_elem_slab, &block, K_NO_WAIT) != 0) {
+		atomic_inc(&app_evt_alloc_failures);
+		return NULL;
+	}
+
+	return block;
 }
 
-static inline struct app_evt_t *app_evt_alloc(void)
+/* Allocate and queue an event; callable from ISRs */
+static bool app_evt_post(enum evt_t type)
 {
-	struct app_evt_t *ev;
+	struct app_evt_t *ev = app_evt_alloc();
 
-	ev = k_heap_alloc(&event_elem_pool,
-			  sizeof(struct app_evt_t),
-			  K_NO_WAIT);
 	if (ev == NULL) {
-		printk("APP event allocation failed!");
-		app_evt_flush();
-
-		ev = k_heap_alloc(&event_elem_pool,
-				  sizeof(struct app_evt_t),
-				  K_NO_WAIT);
-		if (ev == NULL) {
-			printk("APP event memory corrupted.");
-			__ASSERT_NO_MSG(0);
-			return NULL;
-		}
-		return NULL;
+		return false;
 	}
-
-	return ev;
+	ev->event_type = type;
+	app_evt_put(ev);
+	return true;
 }
 
 /* HID */
 
 
-static K_SEM_DEFINE(evt_sem, 0, 1);	/* starts off "not available" */
-
 static struct gpio_callback gpio_callbacks[4];
 
 
@@ -144,40 +175,224 @@ static const char *evt_fail	=	"Unknown event detected!\r\n";
 static const char *set_str	=	"String set to: ";
 static const char *endl		=	"\r\n";
 
-static bool led_signal = false;
-static bool led_error_signal = false;
+/*
+ * LED effects run from kernel timers instead of a 1 ms tick.
+ *
+ * A blink is LED_BLINK_MS on followed by LED_BLINK_MS off; a trigger that
+ * arrives mid-blink is latched and starts the next blink right after, as
+ * the old counter-based loop did. The green LED is a GPIO and is driven
+ * straight from the timer; the red LED is PWM and is applied by the main
+ * loop on MAIN_EVT_LED_ERR.
+ */
+#define LED_BLINK_MS	30
+#define LED_FADE_MS	20
+#define LED_FADE_PERIOD_MS 1000
+
+enum led_blink_phase {
+	LED_BLINK_IDLE,
+	LED_BLINK_ON,
+	LED_BLINK_HOLD,
+};
+
+struct led_blink {
+	struct k_timer timer;
+	atomic_t phase;
+	atomic_t again;
+	void (*set)(bool on);	/* called from timer (ISR) context */
+};
+
+static atomic_t red_led_on;
+
+static void green_led_set(bool on)
+{
+	gpio_pin_set_dt(&led0, on);
+}
+
+static void red_led_set(bool on)
+{
+	atomic_set(&red_led_on, on);
+	k_event_post(&main_events, MAIN_EVT_LED_ERR);
+}
+
+static void led_blink_expiry(struct k_timer *timer)
+{
+	struct led_blink *b = CONTAINER_OF(timer, struct led_blink, timer);
+
+	if (atomic_get(&b->phase) == LED_BLINK_ON) {
+		b->set(false);
+		atomic_set(&b->phase, LED_BLINK_HOLD);
+	} else if (atomic_clear(&b->again)) {
+		b->set(true);
+		atomic_set(&b->phase, LED_BLINK_ON);
+	} else {
+		k_timer_stop(timer);
+		atomic_set(&b->phase, LED_BLINK_IDLE);
+	}
+}
+
+static void led_blink_start(struct led_blink *b)
+{
+	if (!atomic_cas(&b->phase, LED_BLINK_IDLE, LED_BLINK_ON)) {
+		atomic_set(&b->again, 1);
+		return;
+	}
+	b->set(true);
+	k_timer_start(&b->timer, K_MSEC(LED_BLINK_MS), K_MSEC(LED_BLINK_MS));
+}
+
+static struct led_blink green_blink = { .set = green_led_set };
+static struct led_blink red_blink = { .set = red_led_set };
+
+/* Activity indication, callable from any context */
+static void led_blink(void)
+{
+	led_blink_start(&green_blink);
+}
+
+static void led_error_blink(void)
+{
+	led_blink_start(&red_blink);
+}
+
+static void led_fade_expiry(struct k_timer *timer)
+{
+	ARG_UNUSED(timer);
+	k_event_post(&main_events, MAIN_EVT_LED_FADE);
+}
+
+K_TIMER_DEFINE(led_fade_timer, led_fade_expiry, NULL);
+
+/* Main loop wakeups, for measuring idle behaviour */
+static uint32_t main_wakeups;
+static uint32_t main_wakeups_reported;
+static int64_t main_wakeups_reported_at;
 
 static void clear_kbd_report(void)
 {
-	struct app_evt_t *new_evt = app_evt_alloc();
+	app_evt_post(HID_KBD_CLEAR);
+}
+/* CDC ACM output is queued, see cdc_link.c */
 
-	new_evt->event_type = HID_KBD_CLEAR;
-	app_evt_put(new_evt);
-	k_sem_give(&evt_sem);
+static void write_hid_out_stats(void)
+{
+	static const char *const names[HID_IFACE_COUNT] = {
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+		[HID_IFACE_KBD] = "hid",
+#else
+		[HID_IFACE_KBD] = "kbd",
+		[HID_IFACE_MOUSE] = "mouse",
+#endif
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+		[HID_IFACE_MOUSE_REL] = "mouse_rel",
+#endif
+	};
+	struct hid_out_stats st;
+	char line[128];
+	int n;
+
+	for (int i = 0; i < HID_IFACE_COUNT; i++) {
+		hid_out_get_stats(i, &st);
+		n = snprintk(line, sizeof(line),
+			     "HID %s: depth %u high %u dropped %u sent %u "
+			     "coalesced %u\r\n",
+			     names[i], st.depth, st.high_water, st.dropped,
+			     st.sent, st.coalesced);
+		cdc_link_write(line, MIN(n, (int)sizeof(line) - 1));
+	}
 }
-/* CDC ACM */
 
-static volatile bool data_transmitted;
-static volatile bool data_arrived;
+/* Main loop wakeups per second since the previous report, event pool use */
+static void write_main_stats(void)
+{
+	int64_t now = k_uptime_get();
+	int64_t elapsed = now - main_wakeups_reported_at;
+	uint32_t count = main_wakeups - main_wakeups_reported;
+	char line[96];
+	int n;
+
+	if (elapsed <= 0) {
+		return;
+	}
+
+	n = snprintk(line, sizeof(line),
+		     "Main loop: %u wakeups/s, events %u/%u, alloc failed %u\r\n",
+		     (uint32_t)((uint64_t)count * 1000 / elapsed),
+		     k_mem_slab_num_used_get(&event_elem_slab), FIFO_ELEM_COUNT,
+		     (uint32_t)atomic_get(&app_evt_alloc_failures));
+	cdc_link_write(line, MIN(n, (int)sizeof(line) - 1));
 
-static void write_data(const struct device *dev, const char *buf, int len)
+	main_wakeups_reported = main_wakeups;
+	main_wakeups_reported_at = now;
+}
+
+/* CDC ACM itself: bytes waiting and sent, messages dropped, bytes in */
+static void write_cdc_stats(void)
+{
+	struct cdc_link_stats st;
+	char line[80];
+	int n;
+
+	cdc_link_get_stats(&st);
+	n = snprintk(line, sizeof(line),
+		     "CDC: pending %u sent %u dropped %u received %u\r\n",
+		     st.pending, st.sent, st.dropped, st.received);
+	cdc_link_write(line, MIN(n, (int)sizeof(line) - 1));
+}
+
+/* Send text over TX notify, split to fit the negotiated ATT MTU */
+static void notify_text(struct bt_conn *conn, const char *buf, int len)
 {
-	uart_irq_tx_enable(dev);
+	int chunk = bt_gatt_get_mtu(conn) - 3;
 
-	while (len) {
-		int written;
+	if (chunk <= 0) {
+		return;
+	}
 
-		data_transmitted = false;
-		written = uart_fifo_fill(dev, (const uint8_t *)buf, len);
-		while (data_transmitted == false) {
-			k_yield();
+	while (len > 0) {
+		int n = MIN(len, chunk);
+
+		if (bt_hidrelay_send(conn, buf, n)) {
+			break;
 		}
+		buf += n;
+		len -= n;
+	}
+}
 
-		len -= written;
-		buf += written;
+struct notify_all_data {
+	const char *buf;
+	int len;
+};
+
+static void notify_all_cb(struct bt_conn *conn, void *data)
+{
+	const struct notify_all_data *d = data;
+
+	if (bt_hidrelay_subscribed(conn)) {
+		notify_text(conn, d->buf, d->len);
 	}
+}
+
+/* Send text to every central subscribed to TX */
+static void notify_all(const char *buf, int len)
+{
+	struct notify_all_data d = { .buf = buf, .len = len };
 
-	uart_irq_tx_disable(dev);
+	bt_conn_foreach(BT_CONN_TYPE_LE, notify_all_cb, &d);
+}
+
+/* bt_conn_foreach() callback: "LP:" line for one link */
+static void report_link(struct bt_conn *conn, void *data)
+{
+	char report[48];
+	int n = ble_link_format(conn, report, sizeof(report));
+
+	ARG_UNUSED(data);
+
+	cdc_link_write(report, n);
+	if (bt_hidrelay_subscribed(conn)) {
+		notify_text(conn, report, n);
+	}
 }
 
 /* Devices */
@@ -185,11 +400,7 @@ static void write_data(const struct device *dev, const char *buf, int len)
 static void btn0(const struct device *gpio, struct gpio_callback *cb,
 		 uint32_t pins)
 {
-	struct app_evt_t *ev = app_evt_alloc();
-
-	ev->event_type = GPIO_BUTTON_0,
-	app_evt_put(ev);
-	k_sem_give(&evt_sem);
+	app_evt_post(GPIO_BUTTON_0);
 }
 
 int callbacks_configure(const struct gpio_dt_spec *gpio,
@@ -211,10 +422,17 @@ int callbacks_configure(const struct gpio_dt_spec *gpio,
 	return 0;
 }
 
+#if !defined(CONFIG_HIDRELAY_USBD_NEXT)
 static void status_cb(enum usb_dc_status_code status, const uint8_t *param)
 {
-	printk("Status %d", status);
+	if (status == USB_DC_SOF) {
+		/* Every millisecond, keep it quiet */
+		hid_out_sof();
+		return;
+	}
+	LOG_DBG("USB status %d", status);
 }
+#endif
 
 static const struct bt_data ad[] = {
 	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
@@ -225,180 +443,625 @@ static const struct bt_data sd[] = {
 	BT_DATA_BYTES(BT_DATA_UUID128_ALL, BT_UUID_HIDRELAY_SVC_VAL),
 };
 
+/* No central subscribed to TX notifications */
 static bool bt_disconnected = true;
 
+/* Keyboard/mouse state and the token parser live in relay_core */
+BUILD_ASSERT(RELAY_KBD_BITMAP_SIZE == HID_KBD_BITMAP_SIZE);
+
+/*
+ * Input writers: every connected central, and CDC ACM. Each has its own
+ * relay_core, so its own held keys, pointer position and parser state,
+ * and its own sequence marker for FC. The relay_core_ops callbacks get
+ * the writer as ctx.
+ */
+struct input_writer {
+	struct relay_core core;
+	struct bt_conn *conn;	/* NULL for CDC ACM and unused slots */
+	bool subscribed;	/* TX notify on, see subscription_update() */
+	atomic_t seq;		/* last SQ marker, see core_seq() */
+	uint8_t buttons;	/* absolute mouse buttons held */
+	uint8_t rel_buttons;	/* relative mouse buttons held */
+};
+
+/* Indexed by bt_conn_index() */
+static struct input_writer ble_writers[CONFIG_BT_MAX_CONN];
+static struct input_writer cdc_writer;
+/* Centrals by bt_conn_index() still owed their first FC and LP lines */
+static ATOMIC_DEFINE(subscribed_pending, CONFIG_BT_MAX_CONN);
+
+/* Writers take turns on the HID interfaces; also guards arbitration */
+static K_MUTEX_DEFINE(input_lock);
+
+/* Wired input over CDC ACM, see cdc_received() */
+static struct relay_stream cdc_stream;
+/* Set once the CDC ACM host has sent input; it then gets FC/TD lines too */
+static atomic_t cdc_input_seen;
+
+/*
+ * Input arbitration, all under input_lock.
+ *
+ * Each HID device shows the state of the writer that changed it last. A
+ * writer taking a device over sends its whole state, so whatever the
+ * previous owner held is released on the host at once; the previous
+ * owner's state comes back with its next input on that device. When an
+ * owner disconnects, what it held is released.
+ *
+ * "SX:1" locks input to the writer that sends it: input from the others
+ * is dropped and counted until "SX:0" or a disconnect. "SX:2" takes the
+ * lock even from another writer, for an operator taking over from an
+ * automation host.
+ */
+enum input_dev {
+	INPUT_DEV_KBD,
+	INPUT_DEV_MOUSE,
+	INPUT_DEV_MOUSE_REL,
+	INPUT_DEV_CONSUMER,
+	INPUT_DEV_COUNT,
+};
+
+static struct input_writer *input_owner[INPUT_DEV_COUNT];
+static struct input_writer *input_excl;	/* "SX" lock holder */
+static atomic_t input_takeovers;
+static atomic_t input_locked_out;
+
+static bool input_excluded(struct input_writer *w)
+{
+	if (input_excl == NULL || input_excl == w) {
+		return false;
+	}
+	atomic_inc(&input_locked_out);
+	return true;
+}
+
+/* Make @p w the owner of @p dev, unless another writer holds the lock */
+static bool input_claim(struct input_writer *w, enum input_dev dev)
+{
+	if (input_excluded(w)) {
+		return false;
+	}
+	if (input_owner[dev] != w) {
+		if (input_owner[dev] != NULL) {
+			atomic_inc(&input_takeovers);
+		}
+		input_owner[dev] = w;
+	}
+	return true;
+}
+
+/* Release on the host whatever the owner of @p dev holds there */
+static void input_release(enum input_dev dev)
+{
+	static const uint8_t no_keys[HID_KBD_BITMAP_SIZE];
+	struct input_writer *w = input_owner[dev];
+
+	if (w == NULL) {
+		return;
+	}
+	input_owner[dev] = NULL;
+
+	switch (dev) {
+	case INPUT_DEV_KBD:
+		if (w->core.modifiers != 0 ||
+		    memcmp(w->core.keys, no_keys, sizeof(no_keys)) != 0) {
+			hid_keyboard_send_keys(0, no_keys);
+		}
+		break;
+	case INPUT_DEV_MOUSE:
+		if (w->buttons != 0) {
+			hid_mouse_abs_send(0, w->core.x, w->core.y, 0);
+		}
+		break;
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+	case INPUT_DEV_MOUSE_REL:
+		if (w->rel_buttons != 0) {
+			hid_mouse_rel_send(0, 0, 0);
+		}
+		break;
+#endif
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+	case INPUT_DEV_CONSUMER:
+		if (w->core.consumer != 0) {
+			hid_consumer_send(0);
+		}
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+/* "SX:<n>": 0 release, 1 take if free, 2 take from whoever holds it */
+static bool input_excl_set(struct input_writer *w, uint32_t arg)
+{
+	switch (arg) {
+	case 0:
+		if (input_excl == w) {
+			input_excl = NULL;
+		}
+		return input_excl == NULL;
+	case 1:
+		if (input_excl != NULL && input_excl != w) {
+			return false;
+		}
+		break;
+	case 2:
+		break;
+	default:
+		return false;
+	}
+
+	if (input_excl != w) {
+		input_excl = w;
+		/* The others are locked out from now, so is what they hold */
+		for (int dev = 0; dev < INPUT_DEV_COUNT; dev++) {
+			if (input_owner[dev] != w) {
+				input_release(dev);
+			}
+		}
+	}
+	return true;
+}
+
+/* Centrals connected, "SX" lock holder, takeovers, inputs locked out */
+static void write_input_stats(void)
+{
+	char holder[8] = "none";
+	unsigned int centrals = 0;
+	char line[96];
+	int n;
+
+	k_mutex_lock(&input_lock, K_FOREVER);
+	for (size_t i = 0; i < ARRAY_SIZE(ble_writers); i++) {
+		if (ble_writers[i].conn != NULL) {
+			centrals++;
+		}
+		if (input_excl == &ble_writers[i]) {
+			snprintk(holder, sizeof(holder), "ble%u", (unsigned int)i);
+		}
+	}
+	if (input_excl == &cdc_writer) {
+		strcpy(holder, "cdc");
+	}
+	k_mutex_unlock(&input_lock);
+
+	n = snprintk(line, sizeof(line),
+		     "Input: centrals %u/%u, lock %s, takeovers %u, "
+		     "locked out %u\r\n", centrals, CONFIG_BT_MAX_CONN, holder,
+		     (uint32_t)atomic_get(&input_takeovers),
+		     (uint32_t)atomic_get(&input_locked_out));
+	cdc_link_write(line, MIN(n, (int)sizeof(line) - 1));
+}
+
+/*
+ * Under input_lock. The CCC callback only fires for the first central
+ * subscribing and the last one leaving, so each link's own state is
+ * checked here when that fires, when it connects and on each write.
+ */
+static void subscription_update(struct bt_conn *conn, struct input_writer *w)
+{
+	bool subscribed = bt_hidrelay_subscribed(conn);
+
+	if (subscribed == w->subscribed) {
+		return;
+	}
+	w->subscribed = subscribed;
+
+	/* Whatever this central left half-written is stale now */
+	relay_core_resync(&w->core);
+	if (subscribed) {
+		atomic_set_bit(subscribed_pending, bt_conn_index(conn));
+		k_event_post(&main_events, MAIN_EVT_SUBSCRIBED);
+	}
+}
+
+/* bt_conn_foreach() callback */
+static void subscription_check(struct bt_conn *conn, void *data)
+{
+	ARG_UNUSED(data);
+
+	k_mutex_lock(&input_lock, K_FOREVER);
+	subscription_update(conn, &ble_writers[bt_conn_index(conn)]);
+	k_mutex_unlock(&input_lock);
+}
+
 static void notif_enabled(bool enabled, void *ctx)
 {
 	ARG_UNUSED(ctx);
 
-	printk("%s() - %s\n", __func__, (enabled ? "Enabled" : "Disabled"));
+	LOG_INF("Notifications %s", enabled ? "enabled" : "disabled");
 
 	if(enabled){
 		bt_disconnected = false;
-
 	}
 	else{
 		bt_disconnected = true;
 		
 	}
+	k_event_post(&main_events, MAIN_EVT_CONN);
+
+	bt_conn_foreach(BT_CONN_TYPE_LE, subscription_check, NULL);
+}
+
+static bool core_kbd(void *ctx, uint8_t modifiers, const uint8_t *keys)
+{
+	if (!input_claim(ctx, INPUT_DEV_KBD)) {
+		return false;
+	}
+
+	/* NKRO 비트맵 또는 6KRO boot 리포트 형식은 hid_km 에서 결정 */
+	if (!hid_keyboard_send_keys(modifiers, keys)) {
+		LOG_WRN("Keyboard report dropped");
+		return false;
+	}
+	return true;
+}
+
+static bool core_mouse_abs(void *ctx, uint8_t buttons, uint16_t x,
+			   uint16_t y, int8_t wheel)
+{
+	struct input_writer *w = ctx;
+
+	if (!input_claim(w, INPUT_DEV_MOUSE)) {
+		return false;
+	}
+	w->buttons = buttons;
+	return hid_mouse_abs_send(buttons, x, y, wheel);
+}
+
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+static bool core_mouse_rel(void *ctx, uint8_t buttons, int16_t dx, int16_t dy)
+{
+	struct input_writer *w = ctx;
+
+	if (!input_claim(w, INPUT_DEV_MOUSE_REL)) {
+		return false;
+	}
+	w->rel_buttons = buttons;
+	return hid_mouse_rel_send(buttons, dx, dy);
+}
+#endif
+
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+static bool core_consumer(void *ctx, uint16_t usage)
+{
+	if (!input_claim(ctx, INPUT_DEV_CONSUMER)) {
+		return false;
+	}
+	return hid_consumer_send(usage);
+}
+#endif
+
+/* Centrals by bt_conn_index() that asked for the latency histograms */
+static ATOMIC_DEFINE(latency_report_pending, CONFIG_BT_MAX_CONN);
+
+/* @p conn is NULL for a request over CDC ACM, which gets the report anyway */
+static void request_latency_report(struct bt_conn *conn)
+{
+	if (conn != NULL) {
+		atomic_set_bit(latency_report_pending, bt_conn_index(conn));
+	}
+	app_evt_post(LATENCY_REPORT);
+}
+
+/* bt_conn_foreach() callback: the report for each central that asked */
+static void send_latency_report(struct bt_conn *conn, void *data)
+{
+	const struct notify_all_data *d = data;
+
+	if (atomic_test_and_clear_bit(latency_report_pending,
+				      bt_conn_index(conn))) {
+		notify_text(conn, d->buf, d->len);
+	}
+}
+
+#if defined(CONFIG_LOG_RUNTIME_FILTERING)
+/* Log sources "SV" addresses, numbered from 1 */
+static const char *const log_sources[] = {
+	"hid_km", "usbd_init", "main", "ble_link", "hidrelay",
+};
+
+/*
+ * "SV:<level>" sets every source above, "SV:<n><level>" only source n.
+ * Levels are LOG_LEVEL_* values (0 off .. 4 debug) and cannot go above
+ * the level a module was built with.
+ */
+static bool log_level_set(uint32_t arg)
+{
+	uint32_t level = arg % 10;
+	uint32_t n = arg / 10;
+
+	if (level > LOG_LEVEL_DBG || n > ARRAY_SIZE(log_sources)) {
+		return false;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(log_sources); i++) {
+		int id;
+
+		if (n != 0 && i != n - 1) {
+			continue;
+		}
+		/* usbd_init only exists in the usbd stack build */
+		id = log_source_id_get(log_sources[i]);
+		if (id >= 0) {
+			log_filter_set(NULL, Z_LOG_LOCAL_DOMAIN_ID,
+				       (int16_t)id, level);
+		}
+	}
+	return true;
+}
+#endif
+
+/* "S" tokens; ctx is the writer */
+static bool core_command(void *ctx, char action, uint32_t arg)
+{
+	struct input_writer *w = ctx;
+
+	switch (action) {
+	case 'L':
+		/* Latency histograms, answered over TX notify and CDC */
+		request_latency_report(w->conn);
+		return true;
+	case 'P':
+		/* Negotiated ATT MTU / data length */
+		app_evt_post(LINK_REPORT);
+		return true;
+	case 'Z':
+		latency_reset();
+		return true;
+#if defined(CONFIG_LOG_RUNTIME_FILTERING)
+	case 'V':
+		return log_level_set(arg);
+#endif
+	case 'X':
+		return input_excl_set(w, arg);
+	default:
+		return false;
+	}
 }
-static uint8_t pressed_keys[6] = {0};
-static uint8_t current_modifiers = 0;
 
-static void add_key(uint8_t key)
+/*
+ * Credit-based flow control over TX notify: "FC:<seq>,<credits>\n".
+ *
+ * <seq> is the last sequence marker (SQ token / SEQ record) from that
+ * writer whose preceding inputs have all been queued for USB, <credits>
+ * the free HID report slots, shared by every writer. One is sent to a
+ * central when it enables notifications, after each marker, when
+ * credits fall below FC_LOW_CREDITS and when they recover to
+ * FC_RESUME_CREDITS. Posting is a level event bit, so bursts of
+ * markers collapse into one notification carrying the newest values.
+ */
+#define FC_LOW_CREDITS		8
+#define FC_RESUME_CREDITS	16
+
+static atomic_t fc_low;
+static struct hid_out_space_wait fc_space_wait;
+
+static void fc_space_cb(void)
 {
-    for (int i = 0; i < 6; i++) {
-        if (pressed_keys[i] == 0) {
-            pressed_keys[i] = key;
-            return;
-        }
-    }
+	atomic_clear(&fc_low);
+	k_event_post(&main_events, MAIN_EVT_CREDITS);
+}
+
+static void fc_check(void)
+{
+	if (hid_out_credits() < FC_LOW_CREDITS && atomic_cas(&fc_low, 0, 1)) {
+		hid_out_space_wait_arm(&fc_space_wait, FC_RESUME_CREDITS);
+		k_event_post(&main_events, MAIN_EVT_CREDITS);
+	}
 }
 
-/* pressed_keys 배열에서 key 제거 */
-static void remove_key(uint8_t key)
+static void core_seq(void *ctx, uint16_t seq)
 {
-    for (int i = 0; i < 6; i++) {
-        if (pressed_keys[i] == key) {
-            pressed_keys[i] = 0;
-        }
-    }
-    
-	return;
+	struct input_writer *w = ctx;
+
+	atomic_set(&w->seq, seq);
+	k_event_post(&main_events, MAIN_EVT_CREDITS);
 }
 
-/* 전체 상태(Modifiers + pressed_keys[])를 바탕으로 HID 리포트 전송 */
-static void send_full_report(void)
+static int fc_format(char *buf, size_t len, struct input_writer *w)
 {
-    uint8_t rep[8] = {0};
+	int n = snprintk(buf, len, "FC:%u,%u\n", (uint16_t)atomic_get(&w->seq),
+			 hid_out_credits());
 
-    /* rep[0] : Modifier 비트마스크 */
-    rep[0] = current_modifiers;
+	return MIN(n, (int)len - 1);
+}
 
-    /* rep[1] : Reserved(항상 0) */
-    rep[1] = 0;
+/* bt_conn_foreach() callback: each central gets its own marker */
+static void notify_credits(struct bt_conn *conn, void *data)
+{
+	char fc[24];
 
-    /* rep[2..7] : 동시에 눌려있는 일반 키(최대 6개) */
-    for (int i = 0; i < 6; i++) {
-        rep[i + 2] = pressed_keys[i];
-    }
+	ARG_UNUSED(data);
 
-    if (hid_keyboard_send_report(rep)) {
-        printk("Failed to send HID report\n");
-    }
+	if (bt_hidrelay_subscribed(conn)) {
+		notify_text(conn, fc, fc_format(fc, sizeof(fc),
+					&ble_writers[bt_conn_index(conn)]));
+	}
 }
 
-/* modifier 키 비트마스크를 업데이트해주는 함수 */
-void update_modifiers(uint8_t modifier_mask, bool press)
+/*
+ * bt_conn_foreach() callback: a central that has just subscribed starts
+ * off with its credit count and what its link can carry.
+ */
+static void greet_subscriber(struct bt_conn *conn, void *data)
 {
-    if (press) {
-        current_modifiers |= modifier_mask;
-    } else {
-        current_modifiers &= ~modifier_mask;
-    }
-	// printk("Current Modifiers: 0x%02x \n", current_modifiers);
+	char report[48];
+
+	ARG_UNUSED(data);
+
+	if (!atomic_test_and_clear_bit(subscribed_pending,
+				       bt_conn_index(conn))) {
+		return;
+	}
+	notify_credits(conn, NULL);
+	notify_text(conn, report,
+		    ble_link_format(conn, report, sizeof(report)));
 }
-static uint32_t x_pos = 0;
-static uint32_t y_pos = 0;	
+
+static size_t core_text(void *ctx, const uint8_t *utf8, size_t len)
+{
+	size_t n;
+
+	/* Typed text has no owner, but the lock keeps it out too */
+	if (input_excluded(ctx)) {
+		return 0;
+	}
+
+	n = kbd_type_append(utf8, len);
+	if (n < len) {
+		led_error_blink();
+		LOG_WRN("Typing buffer full, dropped %zu bytes", len - n);
+	}
+	return n;
+}
+
+/* kbd_type wake-up, from the RX thread or the USB writer */
+static bool kbd_type_wake(void)
+{
+	return app_evt_post(HID_KBD_STRING);
+}
+
+static void core_event(void *ctx, enum relay_core_event ev, uint32_t arg)
+{
+	ARG_UNUSED(ctx);
+
+	switch (ev) {
+	case RELAY_EV_PARSED:
+		latency_mark_parsed();
+		break;
+	case RELAY_EV_APPLIED:
+		led_blink();
+		break;
+	case RELAY_EV_UNKNOWN_KEY:
+		LOG_WRN("Key not found: 0x%x", arg);
+		led_error_blink();
+		app_evt_post(KEY_UNKNOWN);
+		break;
+	case RELAY_EV_UNSUPPORTED:
+		led_error_blink();
+		LOG_WRN("Input type %u not enabled", arg);
+		break;
+	case RELAY_EV_MALFORMED:
+		led_error_blink();
+		LOG_WRN("Malformed input (err %d)", (int)arg);
+		break;
+	case RELAY_EV_UNKNOWN_CMD:
+		led_error_blink();
+		LOG_WRN("Command not recognized");
+		app_evt_post(CDC_UNKNOWN);
+		break;
+	}
+}
+
+static const struct relay_core_ops core_ops = {
+	.kbd = core_kbd,
+	.mouse_abs = core_mouse_abs,
+#if defined(CONFIG_HIDRELAY_MOUSE_REL)
+	.mouse_rel = core_mouse_rel,
+#endif
+#if defined(CONFIG_HIDRELAY_HID_COMPOSITE)
+	.consumer = core_consumer,
+#endif
+	.command = core_command,
+	.seq = core_seq,
+	.text = core_text,
+	.event = core_event,
+};
 
 static void received(struct bt_conn *conn, const void *data, uint16_t len, void *ctx)
 {
-	char message[CONFIG_BT_L2CAP_TX_MTU + 1] = "";
-	
-	ARG_UNUSED(conn);
+	struct input_writer *w = &ble_writers[bt_conn_index(conn)];
+
 	ARG_UNUSED(ctx);
 
-    size_t copy_len = len < sizeof(message) - 1 ? len : sizeof(message) - 1;
-    memcpy(message, data, copy_len);
-    message[copy_len] = '\0'; // Null-terminate the string
-
- 	char *token = strtok(message, "\n");
-    while (token != NULL) {
-		/* Wire format: <device><action>:<payload> — minimum 4 bytes
-		 * (e.g. "MM:0"). Reject anything shorter to keep the payload
-		 * pointer below from running past the buffer. */
-		size_t tlen = strlen(token);
-		if (tlen < 4 || token[2] != ':') {
-			led_error_signal = true;
-			printk("Malformed token: '%s'\n", token);
-			token = strtok(NULL, "\n");
-			continue;
-		}
+	ble_link_activity(conn);
 
-		char device = token[0];
-		char action = token[1];
-		char *payload = token + 3;
-		uint32_t qt_key;
-
-		if (device == 'K') {
-			if (sscanf(payload, "0x%x", &qt_key) == 1) {
-				bool is_press = (action == 'P');
-				uint8_t hid_key = 0;
-				uint8_t modifier_mask = 0;
-
-				if (get_hid_key(qt_key, &hid_key, &modifier_mask)) {
-					if (modifier_mask != 0) {
-						update_modifiers(modifier_mask, is_press);
-						if (hid_key != 0) {
-							if (is_press) {
-								add_key(hid_key);
-							} else {
-								remove_key(hid_key);
-							}
-						}
-					} else {
-						if (is_press) {
-							add_key(hid_key);
-						} else {
-							remove_key(hid_key);
-						}
-					}
-					led_signal = true;
-					send_full_report();
-				} else if (!is_press) {
-					printk("Key not found: %c:0x%x\n", action, qt_key);
-					struct app_evt_t *ev = app_evt_alloc();
-					led_error_signal = true;
-					ev->event_type = KEY_UNKNOWN;
-					app_evt_put(ev);
-					k_sem_give(&evt_sem);
-				}
-			}
-		} else if (device == 'M') {
-			if (sscanf(payload, "%u,%u", &x_pos, &y_pos) == 2) {
-				int button = -1;
-				switch (action) {
-				case 'L': button = 1; break;        /* left press / drag */
-				case 'R': button = 2; break;        /* right press / drag */
-				case 'M': button = 0; break;        /* move, no button held */
-				case 'S':                           /* left release */
-				case 'E': button = 0; break;        /* right release */
-				}
-				if (button >= 0) {
-					led_signal = true;
-					hid_mouse_abs_send((uint8_t)button, x_pos, y_pos, 0);
-				}
-			}
-		} else if (device == 'W' && action == 'W') {
-			int wheel = 0;
-			if (sscanf(payload, "%d", &wheel) == 1) {
-				if (wheel > 127)  wheel = 127;
-				if (wheel < -127) wheel = -127;
-				led_signal = true;
-				hid_mouse_abs_send(0, x_pos, y_pos, (int8_t)wheel);
-			}
-		} else {
-			led_error_signal = true;
-			printk("Command not recognized: %s\n", token);
-			struct app_evt_t *ev = app_evt_alloc();
-			ev->event_type = CDC_UNKNOWN;
-			app_evt_put(ev);
-			k_sem_give(&evt_sem);
-		}
+	k_mutex_lock(&input_lock, K_FOREVER);
+	subscription_update(conn, w);
+	latency_rx_begin();
+	relay_core_feed(&w->core, data, len, w);
+	latency_rx_end();
+	k_mutex_unlock(&input_lock);
+
+	fc_check();
+}
 
-        token = strtok(NULL, "\n");
+/*
+ * Same command stream over CDC ACM, read out of the cdc_link RX ring by
+ * the main loop. Serial has no write boundaries, so tokens must end
+ * with '\n'; see relay_core_feed_stream().
+ */
+static void cdc_received(const uint8_t *data, size_t len)
+{
+	k_mutex_lock(&input_lock, K_FOREVER);
+	latency_rx_begin();
+	relay_core_feed_stream(&cdc_writer.core, &cdc_stream, data, len,
+			       &cdc_writer);
+	latency_rx_end();
+	k_mutex_unlock(&input_lock);
+
+	if (atomic_cas(&cdc_input_seen, 0, 1)) {
+		k_event_post(&main_events, MAIN_EVT_CREDITS);
 	}
+	fc_check();
+}
 
+/* From the UART callback, which may be an ISR: only wake the main loop */
+static void cdc_rx_ready(void)
+{
+	k_event_post(&main_events, MAIN_EVT_CDC_RX);
+}
+
+static void input_connected(struct bt_conn *conn, uint8_t err)
+{
+	if (err) {
+		return;
+	}
+
+	k_mutex_lock(&input_lock, K_FOREVER);
+	ble_writers[bt_conn_index(conn)].conn = conn;
+	/* A bonded central comes back subscribed */
+	subscription_update(conn, &ble_writers[bt_conn_index(conn)]);
+	k_mutex_unlock(&input_lock);
+}
+
+/* A central went away: release what it holds, forget its state */
+static void input_disconnected(struct bt_conn *conn, uint8_t reason)
+{
+	struct input_writer *w = &ble_writers[bt_conn_index(conn)];
+
+	ARG_UNUSED(reason);
+
+	k_mutex_lock(&input_lock, K_FOREVER);
+	for (int dev = 0; dev < INPUT_DEV_COUNT; dev++) {
+		if (input_owner[dev] == w) {
+			input_release(dev);
+		}
+	}
+	if (input_excl == w) {
+		input_excl = NULL;
+	}
+	relay_core_init(&w->core, &core_ops);
+	w->conn = NULL;
+	w->subscribed = false;
+	atomic_clear_bit(subscribed_pending, bt_conn_index(conn));
+	atomic_clear_bit(latency_report_pending, bt_conn_index(conn));
+	w->buttons = 0;
+	w->rel_buttons = 0;
+	atomic_clear(&w->seq);
+	k_mutex_unlock(&input_lock);
+}
+
+BT_CONN_CB_DEFINE(input_conn_callbacks) = {
+	.connected = input_connected,
+	.disconnected = input_disconnected,
+};
+
+static void link_changed(struct bt_conn *conn)
+{
+	ARG_UNUSED(conn);
+	app_evt_post(LINK_REPORT);
 }
 
 static struct bt_hidrelay_cb hidrelay_cb = {
@@ -431,6 +1094,17 @@ int main(void)
 	struct app_evt_t *ev;
 	int ret;
 
+	latency_init();
+	for (size_t i = 0; i < ARRAY_SIZE(ble_writers); i++) {
+		relay_core_init(&ble_writers[i].core, &core_ops);
+	}
+	relay_core_init(&cdc_writer.core, &core_ops);
+	hid_out_space_wait_init(&fc_space_wait, fc_space_cb);
+	kbd_type_init(kbd_type_wake);
+
+	k_timer_init(&green_blink.timer, led_blink_expiry, NULL);
+	k_timer_init(&red_blink.timer, led_blink_expiry, NULL);
+
 	hid_keyboard_init();
 
 	/* Config BT */
@@ -441,6 +1115,12 @@ int main(void)
 		return err;
 	}
 
+	err = ble_link_init(link_changed);
+	if (err) {
+		printk("Failed to init BLE link management (err %d)\n", err);
+		return err;
+	}
+
 	err = bt_hidrelay_init(&hidrelay_cb, NULL);
 	if (err) {
 		printk("Failed to register HIDRelay cb (err %d)\n", err);
@@ -457,7 +1137,7 @@ int main(void)
 	printk("Advertising started with HIDRelay UUID\n");
 
 
-	if (!device_is_ready(cdc_dev)) {
+	if (cdc_link_init(cdc_dev, cdc_rx_ready)) {
 		printk("CDC ACM device %s is not ready",
 			cdc_dev->name);
 		return 0;
@@ -470,99 +1150,81 @@ int main(void)
 	}
 	
 
+#if defined(CONFIG_HIDRELAY_USBD_NEXT)
+	ret = usbd_relay_enable();
+#else
 	ret = usb_enable(status_cb);
+#endif
 	if (ret != 0) {
 		printk("Failed to enable USB");
 		return 0;
 	}
 
-	int cnt = 0;
-	uint32_t b_fade = 0;
-
-	// int led_blink = 0;
-	int led_blink_cnt = 0;
-	int led_err_blink_cnt = 0;
-
-	const int led_blink_interval = 30;
+	/* Apply the initial link state to the LEDs */
+	k_event_post(&main_events, MAIN_EVT_CONN);
 
 	while (true) {
-		if (cnt++ == 1000)
-		{
-			cnt = 0;
-		}
-		int32_t fade = blue_led.period * sin((double)cnt / 1000.0 * 3.14);
-		uint32_t ufade = fade < 0 ? -fade : fade;
-
-		k_msleep(1);
-		if(bt_disconnected)
-		{
-			if (b_fade != ufade)
-			{
-				b_fade = ufade;
-				ret = pwm_set_dt(&blue_led, blue_led.period, ufade);
-
-				if (ret < 0)
-				{
+		uint32_t events = k_event_wait(&main_events, MAIN_EVT_ALL,
+					       false, K_FOREVER);
+
+		/* Handlers below are level-based, a re-post after this is not lost */
+		k_event_clear(&main_events, events);
+		main_wakeups++;
+
+		if (events & MAIN_EVT_CONN) {
+			if (bt_disconnected) {
+				k_timer_start(&led_fade_timer, K_NO_WAIT,
+					      K_MSEC(LED_FADE_MS));
+			} else {
+				k_timer_stop(&led_fade_timer);
+				ret = pwm_set_dt(&blue_led, blue_led.period,
+						 blue_led.period);
+				if (ret < 0) {
 					printk("Error: Failed to set PWM value.\n");
 					return 0;
 				}
 			}
 		}
-		else //connected
-		{
-			if (b_fade != blue_led.period)
-			{
-				b_fade = blue_led.period;
-				ret = pwm_set_dt(&blue_led, blue_led.period, blue_led.period);
 
-				if (ret < 0)
-				{
-					printk("Error: Failed to set PWM value.\n");
-					return 0;
-				}
+		if ((events & MAIN_EVT_LED_FADE) && bt_disconnected) {
+			uint32_t t = k_uptime_get_32() % LED_FADE_PERIOD_MS;
+			int32_t fade = blue_led.period *
+				       sin((double)t / LED_FADE_PERIOD_MS * 3.14);
+			uint32_t ufade = fade < 0 ? -fade : fade;
+
+			ret = pwm_set_dt(&blue_led, blue_led.period, ufade);
+			if (ret < 0) {
+				printk("Error: Failed to set PWM value.\n");
+				return 0;
 			}
 		}
-		// ret = pwm_set_dt(&blue_led, blue_led.period, ufade);
 
-		if (ret < 0)
-		{
-			printk("Error: Failed to set PWM value.\n");
-			return 0;
-		}
-		if (led_error_signal && led_err_blink_cnt == 0)
-		{
-			led_error_signal = false;
-			led_err_blink_cnt = led_blink_interval * 2;
+		if (events & MAIN_EVT_CDC_RX) {
+			uint8_t rx[64];
+			size_t n;
+
+			while ((n = cdc_link_read(rx, sizeof(rx))) > 0) {
+				cdc_received(rx, n);
+			}
 		}
 
-		if (led_signal && led_blink_cnt == 0)
-		{
-			led_signal = false;
-			led_blink_cnt = led_blink_interval * 2;
+		if (events & MAIN_EVT_SUBSCRIBED) {
+			bt_conn_foreach(BT_CONN_TYPE_LE, greet_subscriber, NULL);
 		}
 
-		if(led_err_blink_cnt > 0)
-		{
-			if (led_err_blink_cnt-- < led_blink_interval)
-			{
-				pwm_set_dt(&red_led, red_led.period, 0);
-			}
-			else
-			{
-				pwm_set_dt(&red_led, red_led.period, red_led.period);
+		if (events & MAIN_EVT_CREDITS) {
+			char fc[24];
+
+			bt_conn_foreach(BT_CONN_TYPE_LE, notify_credits, NULL);
+			if (atomic_get(&cdc_input_seen)) {
+				cdc_link_write(fc, fc_format(fc, sizeof(fc),
+							     &cdc_writer));
 			}
 		}
 
-		if(led_blink_cnt > 0)
-		{
-			if (led_blink_cnt-- < led_blink_interval)
-			{
-				gpio_pin_set_dt(&led0, 0);
-			}
-			else
-			{
-				gpio_pin_set_dt(&led0, 1);
-			}
+		if (events & MAIN_EVT_LED_ERR) {
+			pwm_set_dt(&red_led, red_led.period,
+				   atomic_get(&red_led_on) ? red_led.period : 0);
 		}
 
 		while ((ev = app_evt_get()) != NULL) {
@@ -577,7 +1239,14 @@ int main(void)
 				hid_keyboard_send_report(rep);
 				// hid_int_ep_write(hid0_dev, rep,
 				// 		 sizeof(rep), NULL);
-				write_data(cdc_dev, gpio0, strlen(gpio0));
+				cdc_link_write(gpio0, strlen(gpio0));
+				write_hid_out_stats();
+				write_main_stats();
+				write_cdc_stats();
+				write_input_stats();
+				if (IS_ENABLED(CONFIG_HIDRELAY_LATENCY_TRACE)) {
+					app_evt_post(LATENCY_REPORT);
+				}
 				clear_kbd_report();
 				break;
 			}
@@ -593,7 +1262,7 @@ int main(void)
 			}
 			case KEY_UNKNOWN:
 			{
-				printk("Unknown key event!\n");
+				LOG_DBG("Unknown key event");
 				uint8_t rep[8] = {0};
 				uint8_t rep2[8] = {0};
 				uint8_t crep[] = {0x00, 0x00, 0x00, 0x00,
@@ -613,17 +1282,66 @@ int main(void)
 			}
 			case CDC_UNKNOWN:
 			{
-				write_data(cdc_dev, unknown, strlen(unknown));
+				cdc_link_write(unknown, strlen(unknown));
 				break;
 			}
 			case CDC_STRING:
 			{
-				write_data(cdc_dev, set_str, strlen(set_str));
-				// write_data(cdc_dev, string, strlen(string));
-				write_data(cdc_dev, endl, strlen(endl));
+				cdc_link_write(set_str, strlen(set_str));
+				// cdc_link_write(string, strlen(string));
+				cdc_link_write(endl, strlen(endl));
 
 				break;
 			}
+			case LATENCY_REPORT:
+			{
+				static char report[LAT_STAGE_COUNT * 128];
+				struct notify_all_data d = { .buf = report };
+
+				d.len = latency_format(report, sizeof(report));
+				cdc_link_write(report, d.len);
+				bt_conn_foreach(BT_CONN_TYPE_LE, send_latency_report,
+						&d);
+				break;
+			}
+			case LINK_REPORT:
+			{
+				/* One line per central, each its own link */
+				bt_conn_foreach(BT_CONN_TYPE_LE, report_link, NULL);
+				break;
+			}
+			case HID_KBD_STRING:
+			{
+				struct kbd_type_stats st;
+				struct input_writer *owner;
+				char done[40];
+				int n;
+
+				if (!kbd_type_service()) {
+					break;
+				}
+
+				/*
+				 * Typing overwrote the keyboard state; put back
+				 * whatever the keyboard's owner is still holding.
+				 */
+				k_mutex_lock(&input_lock, K_FOREVER);
+				owner = input_owner[INPUT_DEV_KBD];
+				if (owner != NULL) {
+					hid_keyboard_send_keys(owner->core.modifiers,
+							       owner->core.keys);
+				}
+				k_mutex_unlock(&input_lock);
+
+				kbd_type_get_stats(&st);
+				n = snprintk(done, sizeof(done), "TD:%u,%u,%u\n",
+					     st.typed, st.unmapped, st.dropped);
+				notify_all(done, n);
+				if (atomic_get(&cdc_input_seen)) {
+					cdc_link_write(done, n);
+				}
+				break;
+			}
 			case HID_KBD_CLEAR:
 			{
 				/* Clear kbd report */
@@ -636,8 +1354,8 @@ int main(void)
 			default:
 			{
 				printk("Unknown event to execute");
-				write_data(cdc_dev, evt_fail,
-					   strlen(evt_fail));
+				cdc_link_write(evt_fail,
+					       strlen(evt_fail));
 				break;
 			}
 			break;
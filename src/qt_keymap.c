@@ -0,0 +1,410 @@
+/*
+ * Qt key code -> USB HID usage/modifier table
+ *
+ * The table is laid out at compile time as a direct-indexed array: the
+ * Latin-1 range is indexed by key code, and each page of the 0x0100xxxx
+ * special-key block gets its own contiguous run of slots. get_hid_key()
+ * is therefore a bounds check and one array load.
+ *
+ * No Zephyr dependencies, so the host tools can link it as well.
+ */
+
+#include "qt_keymap.h"
+#include "usb_hid_keys.h"
+
+#define HID_MOD_LCTRL  KEY_MOD_LCTRL
+#define HID_MOD_LSHIFT KEY_MOD_LSHIFT
+#define HID_MOD_LALT   KEY_MOD_LALT
+#define HID_MOD_LMETA  KEY_MOD_LMETA
+#define HID_MOD_RCTRL  KEY_MOD_RCTRL
+#define HID_MOD_RSHIFT KEY_MOD_RSHIFT
+#define HID_MOD_RALT   KEY_MOD_RALT
+#define HID_MOD_RMETA  KEY_MOD_RMETA
+
+typedef struct {
+	uint8_t hid_key;
+	uint8_t modifier;
+	uint8_t mapped;
+} qt_hid_entry_t;
+
+/*
+ * Slot layout. Latin-1 keys start at Qt::Key_Space; special-key pages
+ * are identified by bits 8..15 of the Qt code and only cover the low
+ * bytes actually used.
+ */
+#define QT_LATIN1_FIRST		0x20
+#define QT_LATIN1_COUNT		(0x100 - QT_LATIN1_FIRST)
+#define QT_PAGE00_BASE		QT_LATIN1_COUNT			/* 0x010000xx */
+#define QT_PAGE00_COUNT		0x61
+#define QT_PAGE11_BASE		(QT_PAGE00_BASE + QT_PAGE00_COUNT)	/* 0x010011xx */
+#define QT_PAGE11_COUNT		0x04
+#define QT_SLOT_COUNT		(QT_PAGE11_BASE + QT_PAGE11_COUNT)
+
+/* Unmapped pages evaluate to -1, which fails to compile as an index */
+#define QT_SLOT(k)								\
+	((k) >= QT_LATIN1_FIRST && (k) < 0x100 ? (k) - QT_LATIN1_FIRST :	\
+	 ((k) >> 8) == 0x010000 ? QT_PAGE00_BASE + ((k) & 0xFF) :		\
+	 ((k) >> 8) == 0x010011 ? QT_PAGE11_BASE + ((k) & 0xFF) : -1)
+
+#define QT_MAP(k, hid, mod) [QT_SLOT(k)] = { (hid), (mod), 1 }
+
+static const qt_hid_entry_t qt_hid_map[QT_SLOT_COUNT] = {
+    // ----------------------------
+    // Regular Keys and Symbols
+    // ----------------------------
+    
+    // Space
+    QT_MAP(0x20, KEY_SPACE, 0), // Qt::Key_Space
+
+    // Symbols with Shift modifiers
+    QT_MAP(0x21, KEY_1, HID_MOD_LSHIFT), // Qt::Key_Exclam '!'
+    QT_MAP(0x22, KEY_APOSTROPHE, HID_MOD_LSHIFT), // Qt::Key_QuoteDbl '"'
+    QT_MAP(0x23, KEY_3, HID_MOD_LSHIFT), // Qt::Key_NumberSign '#'
+    QT_MAP(0x24, KEY_4, HID_MOD_LSHIFT), // Qt::Key_Dollar '$'
+    QT_MAP(0x25, KEY_5, HID_MOD_LSHIFT), // Qt::Key_Percent '%'
+    QT_MAP(0x26, KEY_7, HID_MOD_LSHIFT), // Qt::Key_Ampersand '&'
+    QT_MAP(0x27, KEY_APOSTROPHE, 0), // Qt::Key_Apostrophe '''
+    QT_MAP(0x28, KEY_9, HID_MOD_LSHIFT), // Qt::Key_ParenLeft '('
+    QT_MAP(0x29, KEY_0, HID_MOD_LSHIFT), // Qt::Key_ParenRight ')'
+    QT_MAP(0x2a, KEY_KPASTERISK, 0), // Qt::Key_Asterisk '*'
+    QT_MAP(0x2b, KEY_EQUAL, HID_MOD_LSHIFT), // Qt::Key_Plus '+'
+    QT_MAP(0x2c, KEY_COMMA, 0), // Qt::Key_Comma ','
+    QT_MAP(0x2d, KEY_MINUS, 0), // Qt::Key_Minus '-'
+    QT_MAP(0x2e, KEY_DOT, 0), // Qt::Key_Period '.'
+    QT_MAP(0x2f, KEY_SLASH, 0), // Qt::Key_Slash '/'
+
+    // Numbers
+    QT_MAP(0x30, KEY_0, 0), // Qt::Key_0 '0'
+    QT_MAP(0x31, KEY_1, 0), // Qt::Key_1 '1'
+    QT_MAP(0x32, KEY_2, 0), // Qt::Key_2 '2'
+    QT_MAP(0x33, KEY_3, 0), // Qt::Key_3 '3'
+    QT_MAP(0x34, KEY_4, 0), // Qt::Key_4 '4'
+    QT_MAP(0x35, KEY_5, 0), // Qt::Key_5 '5'
+    QT_MAP(0x36, KEY_6, 0), // Qt::Key_6 '6'
+    QT_MAP(0x37, KEY_7, 0), // Qt::Key_7 '7'
+    QT_MAP(0x38, KEY_8, 0), // Qt::Key_8 '8'
+    QT_MAP(0x39, KEY_9, 0), // Qt::Key_9 '9'
+
+    // More Symbols
+    QT_MAP(0x3a, KEY_SEMICOLON, HID_MOD_LSHIFT), // Qt::Key_Colon ':'
+    QT_MAP(0x3b, KEY_SEMICOLON, 0), // Qt::Key_Semicolon ';'
+    QT_MAP(0x3c, KEY_COMMA, HID_MOD_LSHIFT), // Qt::Key_Less '<'
+    QT_MAP(0x3d, KEY_EQUAL, 0), // Qt::Key_Equal '='
+    QT_MAP(0x3e, KEY_DOT, HID_MOD_LSHIFT), // Qt::Key_Greater '>'
+    QT_MAP(0x3f, KEY_SLASH, HID_MOD_LSHIFT), // Qt::Key_Question '?'
+    QT_MAP(0x40, KEY_2, HID_MOD_LSHIFT), // Qt::Key_At '@'
+    // Letters
+    QT_MAP(0x41, KEY_A, 0), // Qt::Key_A 'A'
+    QT_MAP(0x42, KEY_B, 0), // Qt::Key_B 'B'
+    QT_MAP(0x43, KEY_C, 0), // Qt::Key_C 'C'
+    QT_MAP(0x44, KEY_D, 0), // Qt::Key_D 'D'
+    QT_MAP(0x45, KEY_E, 0), // Qt::Key_E 'E'
+    QT_MAP(0x46, KEY_F, 0), // Qt::Key_F 'F'
+    QT_MAP(0x47, KEY_G, 0), // Qt::Key_G 'G'
+    QT_MAP(0x48, KEY_H, 0), // Qt::Key_H 'H'
+    QT_MAP(0x49, KEY_I, 0), // Qt::Key_I 'I'
+    QT_MAP(0x4a, KEY_J, 0), // Qt::Key_J 'J'
+    QT_MAP(0x4b, KEY_K, 0), // Qt::Key_K 'K'
+    QT_MAP(0x4c, KEY_L, 0), // Qt::Key_L 'L'
+    QT_MAP(0x4d, KEY_M, 0), // Qt::Key_M 'M'
+    QT_MAP(0x4e, KEY_N, 0), // Qt::Key_N 'N'
+    QT_MAP(0x4f, KEY_O, 0), // Qt::Key_O 'O'
+    QT_MAP(0x50, KEY_P, 0), // Qt::Key_P 'P'
+    QT_MAP(0x51, KEY_Q, 0), // Qt::Key_Q 'Q'
+    QT_MAP(0x52, KEY_R, 0), // Qt::Key_R 'R'
+    QT_MAP(0x53, KEY_S, 0), // Qt::Key_S 'S'
+    QT_MAP(0x54, KEY_T, 0), // Qt::Key_T 'T'
+    QT_MAP(0x55, KEY_U, 0), // Qt::Key_U 'U'
+    QT_MAP(0x56, KEY_V, 0), // Qt::Key_V 'V'
+    QT_MAP(0x57, KEY_W, 0), // Qt::Key_W 'W'
+    QT_MAP(0x58, KEY_X, 0), // Qt::Key_X 'X'
+    QT_MAP(0x59, KEY_Y, 0), // Qt::Key_Y 'Y'
+    QT_MAP(0x5a, KEY_Z, 0), // Qt::Key_Z 'Z'
+
+    // Additional Symbols
+    QT_MAP(0x5b, KEY_LEFTBRACE, 0), // Qt::Key_BracketLeft '['
+    QT_MAP(0x5c, KEY_BACKSLASH, 0), // Qt::Key_Backslash '\'
+    QT_MAP(0x5d, KEY_RIGHTBRACE, 0), // Qt::Key_BracketRight ']'
+    QT_MAP(0x5e, KEY_GRAVE, HID_MOD_LSHIFT), // Qt::Key_AsciiCircum '^'
+    QT_MAP(0x5f, KEY_MINUS, HID_MOD_LSHIFT), // Qt::Key_Underscore '_'
+    QT_MAP(0x60, KEY_GRAVE, 0), // Qt::Key_QuoteLeft '`'
+
+    QT_MAP(0x7b, KEY_LEFTBRACE, HID_MOD_LSHIFT), // Qt::Key_BraceLeft '{'
+    QT_MAP(0x7c, KEY_BACKSLASH, HID_MOD_LSHIFT), // Qt::Key_Bar '|'
+    QT_MAP(0x7d, KEY_RIGHTBRACE, HID_MOD_LSHIFT), // Qt::Key_BraceRight '}'
+    QT_MAP(0x7e, KEY_GRAVE, HID_MOD_LSHIFT), // Qt::Key_AsciiTilde '~'
+
+    // ----------------------------
+    // Function Keys
+    // ----------------------------
+    QT_MAP(0x01000030, KEY_F1, 0), // Qt::Key_F1
+    QT_MAP(0x01000031, KEY_F2, 0), // Qt::Key_F2
+    QT_MAP(0x01000032, KEY_F3, 0), // Qt::Key_F3
+    QT_MAP(0x01000033, KEY_F4, 0), // Qt::Key_F4
+    QT_MAP(0x01000034, KEY_F5, 0), // Qt::Key_F5
+    QT_MAP(0x01000035, KEY_F6, 0), // Qt::Key_F6
+    QT_MAP(0x01000036, KEY_F7, 0), // Qt::Key_F7
+    QT_MAP(0x01000037, KEY_F8, 0), // Qt::Key_F8
+    QT_MAP(0x01000038, KEY_F9, 0), // Qt::Key_F9
+    QT_MAP(0x01000039, KEY_F10, 0), // Qt::Key_F10
+    QT_MAP(0x0100003a, KEY_F11, 0), // Qt::Key_F11
+    QT_MAP(0x0100003b, KEY_F12, 0), // Qt::Key_F12
+    QT_MAP(0x0100003c, KEY_F13, 0), // Qt::Key_F13
+    QT_MAP(0x0100003d, KEY_F14, 0), // Qt::Key_F14
+    QT_MAP(0x0100003e, KEY_F15, 0), // Qt::Key_F15
+    QT_MAP(0x0100003f, KEY_F16, 0), // Qt::Key_F16
+    QT_MAP(0x01000040, KEY_F17, 0), // Qt::Key_F17
+    QT_MAP(0x01000041, KEY_F18, 0), // Qt::Key_F18
+    QT_MAP(0x01000042, KEY_F19, 0), // Qt::Key_F19
+    QT_MAP(0x01000043, KEY_F20, 0), // Qt::Key_F20
+    QT_MAP(0x01000044, KEY_F21, 0), // Qt::Key_F21
+    QT_MAP(0x01000045, KEY_F22, 0), // Qt::Key_F22
+    QT_MAP(0x01000046, KEY_F23, 0), // Qt::Key_F23
+    QT_MAP(0x01000047, KEY_F24, 0), // Qt::Key_F24
+    QT_MAP(0x01000048, KEY_NONE, 0), // Qt::Key_F25
+    QT_MAP(0x01000049, KEY_NONE, 0), // Qt::Key_F26
+    QT_MAP(0x0100004a, KEY_NONE, 0), // Qt::Key_F27
+    QT_MAP(0x0100004b, KEY_NONE, 0), // Qt::Key_F28
+    QT_MAP(0x0100004c, KEY_NONE, 0), // Qt::Key_F29
+    QT_MAP(0x0100004d, KEY_NONE, 0), // Qt::Key_F30
+    QT_MAP(0x0100004e, KEY_NONE, 0), // Qt::Key_F31
+    QT_MAP(0x0100004f, KEY_NONE, 0), // Qt::Key_F32
+    QT_MAP(0x01000050, KEY_NONE, 0), // Qt::Key_F33
+    QT_MAP(0x01000051, KEY_NONE, 0), // Qt::Key_F34
+    QT_MAP(0x01000052, KEY_NONE, 0), // Qt::Key_F35
+
+    // ----------------------------
+    // Modifier Keys
+    // ----------------------------
+    QT_MAP(0x01000020, KEY_LEFTSHIFT, HID_MOD_LSHIFT), // Qt::Key_Shift
+    QT_MAP(0x01000021, KEY_LEFTCTRL, HID_MOD_LCTRL),   // Qt::Key_Control
+    QT_MAP(0x01000022, KEY_LEFTMETA, HID_MOD_LMETA),   // Qt::Key_Meta
+    QT_MAP(0x01000023, KEY_LEFTALT, HID_MOD_LALT),     // Qt::Key_Alt
+    QT_MAP(0x01001103, KEY_RIGHTALT, HID_MOD_RALT),    // Qt::Key_AltGr
+
+    // ----------------------------
+    // Lock Keys
+    // ----------------------------
+    QT_MAP(0x01000024, KEY_CAPSLOCK, 0), // Qt::Key_CapsLock
+    QT_MAP(0x01000025, KEY_NUMLOCK, 0), // Qt::Key_NumLock
+    QT_MAP(0x01000026, KEY_SCROLLLOCK, 0), // Qt::Key_ScrollLock
+
+    // ----------------------------
+    // Special Keys
+    // ----------------------------
+    QT_MAP(0x01000000, KEY_ESC, 0), // Qt::Key_Escape
+    QT_MAP(0x01000001, KEY_TAB, 0), // Qt::Key_Tab
+    QT_MAP(0x01000002, KEY_BACKSPACE, 0), // Qt::Key_Backtab
+    QT_MAP(0x01000003, KEY_BACKSPACE, 0), // Qt::Key_Backspace
+    QT_MAP(0x01000004, KEY_ENTER, 0), // Qt::Key_Return
+    QT_MAP(0x01000005, KEY_KPENTER, 0), // Qt::Key_Enter
+    QT_MAP(0x01000006, KEY_INSERT, 0), // Qt::Key_Insert
+    QT_MAP(0x01000007, KEY_DELETE, 0), // Qt::Key_Delete
+    QT_MAP(0x01000008, KEY_PAUSE, 0), // Qt::Key_Pause
+    QT_MAP(0x01000009, KEY_SYSRQ, 0), // Qt::Key_Print
+    QT_MAP(0x0100000a, KEY_SYSRQ, 0), // Qt::Key_SysReq
+    // QT_MAP(0x0100000b, KEY_CLEAR, 0), // Qt::Key_Clear
+
+    QT_MAP(0x01000010, KEY_HOME, 0), // Qt::Key_Home
+    QT_MAP(0x01000011, KEY_END, 0), // Qt::Key_End
+    QT_MAP(0x01000012, KEY_LEFT, 0), // Qt::Key_Left
+    QT_MAP(0x01000013, KEY_UP, 0), // Qt::Key_Up
+    QT_MAP(0x01000014, KEY_RIGHT, 0), // Qt::Key_Right
+    QT_MAP(0x01000015, KEY_DOWN, 0), // Qt::Key_Down
+    QT_MAP(0x01000016, KEY_PAGEUP, 0), // Qt::Key_PageUp
+    QT_MAP(0x01000017, KEY_PAGEDOWN, 0), // Qt::Key_PageDown
+
+    QT_MAP(0x01000053, KEY_FRONT, 0), // Qt::Key_Super_L
+    QT_MAP(0x01000054, KEY_FRONT, 0), // Qt::Key_Super_R
+    QT_MAP(0x01000055, KEY_PROPS, 0), // Qt::Key_Menu
+    QT_MAP(0x01000056, KEY_NONE, 0), // Qt::Key_Hyper_L
+    QT_MAP(0x01000057, KEY_NONE, 0), // Qt::Key_Hyper_R
+    QT_MAP(0x01000058, KEY_HELP, 0), // Qt::Key_Help
+    QT_MAP(0x01000059, KEY_NONE, 0), // Qt::Key_Direction_L
+    QT_MAP(0x01000060, KEY_NONE, 0), // Qt::Key_Direction_R
+
+    // ----------------------------
+    // Additional Special Keys
+    // ----------------------------
+    QT_MAP(0x0a0, KEY_NONE, 0), // Qt::Key_nobreakspace
+    QT_MAP(0x0a1, KEY_NONE, 0), // Qt::Key_exclamdown
+    QT_MAP(0x0a2, KEY_NONE, 0), // Qt::Key_cent
+    QT_MAP(0x0a3, KEY_NONE, 0), // Qt::Key_sterling
+    QT_MAP(0x0a4, KEY_NONE, 0), // Qt::Key_currency
+    QT_MAP(0x0a5, KEY_YEN, 0), // Qt::Key_yen
+    QT_MAP(0x0a6, KEY_NONE, 0), // Qt::Key_brokenbar
+    QT_MAP(0x0a7, KEY_NONE, 0), // Qt::Key_section
+    QT_MAP(0x0a8, KEY_NONE, 0), // Qt::Key_diaeresis
+    QT_MAP(0x0a9, KEY_NONE, 0), // Qt::Key_copyright
+    QT_MAP(0x0aa, KEY_NONE, 0), // Qt::Key_ordfeminine
+    QT_MAP(0x0ab, KEY_NONE, 0), // Qt::Key_guillemotleft
+    QT_MAP(0x0ac, KEY_NONE, 0), // Qt::Key_notsign
+    QT_MAP(0x0ad, KEY_NONE, 0), // Qt::Key_hyphen
+    QT_MAP(0x0ae, KEY_NONE, 0), // Qt::Key_registered
+    QT_MAP(0x0af, KEY_NONE, 0), // Qt::Key_macron
+    QT_MAP(0x0b0, KEY_NONE, 0), // Qt::Key_degree
+    QT_MAP(0x0b1, KEY_NONE, 0), // Qt::Key_plusminus
+    QT_MAP(0x0b2, KEY_NONE, 0), // Qt::Key_twosuperior
+    QT_MAP(0x0b3, KEY_NONE, 0), // Qt::Key_threesuperior
+    QT_MAP(0x0b4, KEY_NONE, 0), // Qt::Key_acute
+    QT_MAP(0x0b5, KEY_NONE, 0), // Qt::Key_micro
+    QT_MAP(0x0b6, KEY_NONE, 0), // Qt::Key_paragraph
+    QT_MAP(0x0b7, KEY_NONE, 0), // Qt::Key_periodcentered
+    QT_MAP(0x0b8, KEY_NONE, 0), // Qt::Key_cedilla
+    QT_MAP(0x0b9, KEY_NONE, 0), // Qt::Key_onesuperior
+    QT_MAP(0x0ba, KEY_NONE, 0), // Qt::Key_masculine
+    QT_MAP(0x0bb, KEY_NONE, 0), // Qt::Key_guillemotright
+    QT_MAP(0x0bc, KEY_NONE, 0), // Qt::Key_onequarter
+    QT_MAP(0x0bd, KEY_NONE, 0), // Qt::Key_onehalf
+    QT_MAP(0x0be, KEY_NONE, 0), // Qt::Key_threequarters
+    QT_MAP(0x0bf, KEY_NONE, 0), // Qt::Key_questiondown
+
+    QT_MAP(0x0c0, KEY_NONE, 0), // Qt::Key_Agrave
+    QT_MAP(0x0c1, KEY_NONE, 0), // Qt::Key_Aacute
+    QT_MAP(0x0c2, KEY_NONE, 0), // Qt::Key_Acircumflex
+    QT_MAP(0x0c3, KEY_NONE, 0), // Qt::Key_Atilde
+    QT_MAP(0x0c4, KEY_NONE, 0), // Qt::Key_Adiaeresis
+    QT_MAP(0x0c5, KEY_NONE, 0), // Qt::Key_Aring
+    QT_MAP(0x0c6, KEY_NONE, 0), // Qt::Key_AE
+    QT_MAP(0x0c7, KEY_NONE, 0), // Qt::Key_Ccedilla
+    QT_MAP(0x0c8, KEY_NONE, 0), // Qt::Key_Egrave
+    QT_MAP(0x0c9, KEY_NONE, 0), // Qt::Key_Eacute
+    QT_MAP(0x0ca, KEY_NONE, 0), // Qt::Key_Ecircumflex
+    QT_MAP(0x0cb, KEY_NONE, 0), // Qt::Key_Ediaeresis
+    QT_MAP(0x0cc, KEY_NONE, 0), // Qt::Key_Igrave
+    QT_MAP(0x0cd, KEY_NONE, 0), // Qt::Key_Iacute
+    QT_MAP(0x0ce, KEY_NONE, 0), // Qt::Key_Icircumflex
+    QT_MAP(0x0cf, KEY_NONE, 0), // Qt::Key_Idiaeresis
+    QT_MAP(0x0d0, KEY_NONE, 0), // Qt::Key_ETH
+    QT_MAP(0x0d1, KEY_NONE, 0), // Qt::Key_Ntilde
+    QT_MAP(0x0d2, KEY_NONE, 0), // Qt::Key_Ograve
+    QT_MAP(0x0d3, KEY_NONE, 0), // Qt::Key_Oacute
+    QT_MAP(0x0d4, KEY_NONE, 0), // Qt::Key_Ocircumflex
+    QT_MAP(0x0d5, KEY_NONE, 0), // Qt::Key_Otilde
+    QT_MAP(0x0d6, KEY_O, 0), // Qt::Key_Odiaeresis 'Ö' mapped to 'O'
+    QT_MAP(0x0d7, KEY_KPMINUS, 0), // Qt::Key_multiply '×' mapped to Keypad Minus
+    // QT_MAP(0x0d8, KEY_OOBLIQUE, 0), // Qt::Key_Ooblique 'Ø'
+    QT_MAP(0x0d9, KEY_U, 0), // Qt::Key_Ugrave 'Ù' mapped to 'U'
+    QT_MAP(0x0da, KEY_U, 0), // Qt::Key_Uacute 'Ú' mapped to 'U'
+    QT_MAP(0x0db, KEY_U, 0), // Qt::Key_Ucircumflex 'Û' mapped to 'U'
+    QT_MAP(0x0dc, KEY_U, 0), // Qt::Key_Udiaeresis 'Ü' mapped to 'U'
+    QT_MAP(0x0dd, KEY_Y, 0), // Qt::Key_Yacute 'Ý' mapped to 'Y'
+    QT_MAP(0x0de, KEY_NONE, 0), // Qt::Key_THORN 'Þ'
+    QT_MAP(0x0df, KEY_NONE, 0), // Qt::Key_ssharp 'ß'
+    // QT_MAP(0x0f7, KEY_DIVISION, 0), // Qt::Key_division '÷'
+    QT_MAP(0x0ff, KEY_NONE, 0), // Qt::Key_ydiaeresis 'ÿ'
+
+    // ----------------------------
+    // Media and Additional Keys (Optional)
+    // ----------------------------
+    // Depending on your application's needs, you can map additional media keys here.
+    // Example:
+    // QT_MAP(0x... , KEY_MEDIA_PLAYPAUSE, 0), // Qt::Key_Media_PlayPause
+    // QT_MAP(0x... , KEY_MEDIA_VOLUMEUP, 0), // Qt::Key_Media_VolumeUp
+    // Add more as needed.
+
+    // ----------------------------
+    // Unmapped or Unsupported Keys
+    // ----------------------------
+    // Keys that do not have a direct HID equivalent are mapped to KEY_NONE.
+    // You can handle these cases as needed in your application logic.
+    
+    // Example:
+    // QT_MAP(0x01000053, KEY_NONE, 0), // Qt::Key_Super_L (already mapped as KEY_FRONT)
+    // QT_MAP(0x01000054, KEY_NONE, 0), // Qt::Key_Super_R (already mapped as KEY_FRONT)
+    // etc.
+};
+
+struct qt_key_page {
+	uint16_t base;
+	uint8_t count;
+};
+
+/* Indexed by bits 8..15 of a 0x0100xxxx key; count 0 means no page */
+static const struct qt_key_page qt_special_pages[] = {
+	[0x00] = { QT_PAGE00_BASE, QT_PAGE00_COUNT },
+	[0x11] = { QT_PAGE11_BASE, QT_PAGE11_COUNT },
+};
+
+#define QT_SPECIAL_PAGE_COUNT \
+	(sizeof(qt_special_pages) / sizeof(qt_special_pages[0]))
+
+// Function to get HID key code and modifier from Qt key code
+bool get_hid_key(uint32_t qt_key, uint8_t *hid_key, uint8_t *modifier)
+{
+	const qt_hid_entry_t *ent;
+	uint32_t slot;
+
+	if (qt_key - QT_LATIN1_FIRST < QT_LATIN1_COUNT) {
+		slot = qt_key - QT_LATIN1_FIRST;
+	} else if ((qt_key >> 16) == 0x0100) {
+		uint32_t page = (qt_key >> 8) & 0xFF;
+		uint32_t low = qt_key & 0xFF;
+
+		if (page >= QT_SPECIAL_PAGE_COUNT ||
+		    low >= qt_special_pages[page].count) {
+			return false;
+		}
+		slot = qt_special_pages[page].base + low;
+	} else {
+		return false;
+	}
+
+	ent = &qt_hid_map[slot];
+	if (!ent->mapped) {
+		return false; // Key not found
+	}
+
+	*hid_key = ent->hid_key;
+	*modifier = ent->modifier;
+	return true;
+}
+
+bool get_hid_char(uint32_t ch, uint8_t *hid_key, uint8_t *modifier)
+{
+	switch (ch) {
+	case '\n':
+		return get_hid_key(0x01000004, hid_key, modifier); // Qt::Key_Return
+	case '\t':
+		return get_hid_key(0x01000001, hid_key, modifier); // Qt::Key_Tab
+	default:
+		break;
+	}
+
+	/* Qt letter keys are the upper case codes, shift selects the case */
+	if (ch >= 'a' && ch <= 'z') {
+		return get_hid_key(ch - 'a' + 'A', hid_key, modifier);
+	}
+	if (ch >= 'A' && ch <= 'Z') {
+		if (!get_hid_key(ch, hid_key, modifier)) {
+			return false;
+		}
+		*modifier |= HID_MOD_LSHIFT;
+		return true;
+	}
+	if (ch < 0x20 || ch > 0x7e) {
+		return false;
+	}
+	return get_hid_key(ch, hid_key, modifier);
+}
+
+bool get_hid_consumer(uint32_t qt_key, uint16_t *usage)
+{
+	switch (qt_key) {
+	case 0x01000070: *usage = 0x00EA; break; // Qt::Key_VolumeDown
+	case 0x01000071: *usage = 0x00E2; break; // Qt::Key_VolumeMute
+	case 0x01000072: *usage = 0x00E9; break; // Qt::Key_VolumeUp
+	case 0x01000080: *usage = 0x00B0; break; // Qt::Key_MediaPlay
+	case 0x01000081: *usage = 0x00B7; break; // Qt::Key_MediaStop
+	case 0x01000082: *usage = 0x00B6; break; // Qt::Key_MediaPrevious
+	case 0x01000083: *usage = 0x00B5; break; // Qt::Key_MediaNext
+	case 0x01000084: *usage = 0x00B2; break; // Qt::Key_MediaRecord
+	case 0x01000085: *usage = 0x00B1; break; // Qt::Key_MediaPause
+	case 0x01000086: *usage = 0x00CD; break; // Qt::Key_MediaTogglePlayPause
+	case 0x010000b2: *usage = 0x006F; break; // Qt::Key_MonBrightnessUp
+	case 0x010000b3: *usage = 0x0070; break; // Qt::Key_MonBrightnessDown
+	default:
+		return false;
+	}
+	return true;
+}
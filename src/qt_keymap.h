@@ -0,0 +1,32 @@
+#ifndef QT_KEYMAP_H
+#define QT_KEYMAP_H
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Translate a Qt key code into a HID usage and modifier mask
+ *
+ * O(1): direct table index, no search.
+ *
+ * @return false if the key has no entry in the table
+ */
+bool get_hid_key(uint32_t qt_key, uint8_t *hid_key, uint8_t *modifier);
+
+/**
+ * @brief Key and modifiers that type Unicode character @p ch
+ *
+ * Uses the same table, so it covers what the US layout can type
+ * directly: printable ASCII, newline (Return) and tab.
+ *
+ * @return false if the character cannot be typed
+ */
+bool get_hid_char(uint32_t ch, uint8_t *hid_key, uint8_t *modifier);
+
+/**
+ * @brief Consumer page usage (media, volume, brightness) for a Qt key
+ *
+ * @return false if @p qt_key is not a consumer control key
+ */
+bool get_hid_consumer(uint32_t qt_key, uint16_t *usage);
+
+#endif // QT_KEYMAP_H
@@ -0,0 +1,716 @@
+/*
+ * HID Relay input core - key state machine and text token parser
+ */
+
+#include "relay_core.h"
+#include "qt_keymap.h"
+
+#include <string.h>
+
+#define CLAMP_I(v, lo, hi)	((v) < (lo) ? (lo) : ((v) > (hi) ? (hi) : (v)))
+
+/* relay_proto_decode() callback context */
+struct core_call {
+	struct relay_core *core;
+	void *ctx;
+};
+
+static void core_event(struct relay_core *core, void *ctx,
+		       enum relay_core_event ev, uint32_t arg)
+{
+	if (core->ops->event) {
+		core->ops->event(ctx, ev, arg);
+	}
+}
+
+void relay_core_init(struct relay_core *core, const struct relay_core_ops *ops)
+{
+	memset(core, 0, sizeof(*core));
+	core->ops = ops;
+}
+
+static void add_key(struct relay_core *core, uint8_t key)
+{
+	if (key != 0) {
+		core->keys[key >> 3] |= (uint8_t)(1u << (key & 7));
+	}
+}
+
+static void remove_key(struct relay_core *core, uint8_t key)
+{
+	core->keys[key >> 3] &= (uint8_t)~(1u << (key & 7));
+}
+
+static void update_modifiers(struct relay_core *core, uint8_t modifier_mask,
+			     bool press)
+{
+	if (press) {
+		core->modifiers |= modifier_mask;
+	} else {
+		core->modifiers &= (uint8_t)~modifier_mask;
+	}
+}
+
+static void handle_key(struct relay_core *core, uint32_t qt_key, bool press,
+		       void *ctx)
+{
+	uint8_t hid_key = 0;
+	uint8_t modifier_mask = 0;
+	uint16_t usage;
+
+	if (core->ops->consumer && get_hid_consumer(qt_key, &usage)) {
+		/* One consumer control at a time, the latest press wins */
+		if (press) {
+			core->consumer = usage;
+		} else if (core->consumer == usage) {
+			core->consumer = 0;
+		} else {
+			return;
+		}
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->consumer(ctx, core->consumer);
+		return;
+	}
+
+	if (!get_hid_key(qt_key, &hid_key, &modifier_mask)) {
+		/* Reported once per key, on release */
+		if (!press) {
+			core_event(core, ctx, RELAY_EV_UNKNOWN_KEY, qt_key);
+		}
+		return;
+	}
+
+	if (modifier_mask != 0) {
+		update_modifiers(core, modifier_mask, press);
+	}
+	if (press) {
+		add_key(core, hid_key);
+	} else if (hid_key != 0) {
+		remove_key(core, hid_key);
+	}
+
+	core_event(core, ctx, RELAY_EV_APPLIED, 0);
+	core->ops->kbd(ctx, core->modifiers, core->keys);
+}
+
+/*
+ * Move to a snapshot of the host's keyboard state. Releases go out in a
+ * report of their own ahead of presses, so a host never sees a new key
+ * together with a modifier that has already been let go. A snapshot
+ * that matches the current state sends nothing.
+ */
+static void apply_kbd_state(struct relay_core *core, uint8_t modifiers,
+			    const uint8_t *keys, size_t len, void *ctx)
+{
+	uint8_t next[RELAY_KBD_BITMAP_SIZE] = {0};
+	bool release = false;
+	bool press = false;
+
+	memcpy(next, keys, len < sizeof(next) ? len : sizeof(next));
+
+	/*
+	 * Usages 0xE0..0xE7 are the modifier bits. Fold them on both sides:
+	 * KP tokens for modifier keys leave them set in core->keys too.
+	 */
+	modifiers |= next[0xE0 >> 3];
+	next[0xE0 >> 3] = 0;
+	core->modifiers |= core->keys[0xE0 >> 3];
+	core->keys[0xE0 >> 3] = 0;
+
+	for (size_t i = 0; i < sizeof(next); i++) {
+		release |= (core->keys[i] & ~next[i]) != 0;
+		press |= (next[i] & ~core->keys[i]) != 0;
+	}
+	release |= (core->modifiers & ~modifiers) != 0;
+	press |= (modifiers & ~core->modifiers) != 0;
+
+	if (release && press) {
+		for (size_t i = 0; i < sizeof(next); i++) {
+			core->keys[i] &= next[i];
+		}
+		core->modifiers &= modifiers;
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->kbd(ctx, core->modifiers, core->keys);
+	}
+	if (release || press) {
+		memcpy(core->keys, next, sizeof(next));
+		core->modifiers = modifiers;
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->kbd(ctx, core->modifiers, core->keys);
+	}
+}
+
+void relay_core_input(struct relay_core *core, const struct relay_input *in,
+		      void *ctx)
+{
+	if (in->type == RELAY_IN_SEQ) {
+		if (core->ops->seq) {
+			core->ops->seq(ctx, in->seq.seq);
+		}
+		return;
+	}
+	if (in->type == RELAY_IN_TEXT) {
+		if (core->ops->text == NULL) {
+			core_event(core, ctx, RELAY_EV_UNSUPPORTED, in->type);
+			return;
+		}
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->text(ctx, in->text.data, in->text.len);
+		return;
+	}
+
+	core_event(core, ctx, RELAY_EV_PARSED, 0);
+
+	switch (in->type) {
+	case RELAY_IN_KEY:
+		handle_key(core, in->key.qt_key, in->key.press, ctx);
+		break;
+	case RELAY_IN_KBD_STATE:
+		apply_kbd_state(core, in->kbd_state.modifiers, in->kbd_state.keys,
+				in->kbd_state.len, ctx);
+		break;
+	case RELAY_IN_MOUSE_ABS:
+		core->x = in->mouse.x;
+		core->y = in->mouse.y;
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->mouse_abs(ctx, in->mouse.buttons, core->x, core->y, 0);
+		break;
+	case RELAY_IN_MOUSE_REL:
+		if (core->ops->mouse_rel == NULL) {
+			core_event(core, ctx, RELAY_EV_UNSUPPORTED, in->type);
+			break;
+		}
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->mouse_rel(ctx, in->rel.buttons, in->rel.dx, in->rel.dy);
+		break;
+	case RELAY_IN_WHEEL:
+	{
+		/* Descriptor range is symmetric, -128 is not reportable */
+		int8_t wheel = in->wheel.delta < -127 ? -127 : in->wheel.delta;
+
+		core_event(core, ctx, RELAY_EV_APPLIED, 0);
+		core->ops->mouse_abs(ctx, 0, core->x, core->y, wheel);
+		break;
+	}
+	case RELAY_IN_SEQ:
+	case RELAY_IN_TEXT:
+		break;
+	}
+}
+
+/* -----------------------------------------------------------------------------
+ * Text tokens
+ *
+ * "<device><action>:<payload>", parsed a byte at a time straight out of
+ * the write. Numeric payloads are accumulated as the digits go by and
+ * applied when the token ends; text payloads are handed on in runs that
+ * point into the write.
+ * -----------------------------------------------------------------------------
+ */
+
+/* Payload syntax, picked when the ':' goes by */
+enum text_kind {
+	TK_UNKNOWN,	/* unknown device or action */
+	TK_KEY,		/* 0x<hex> */
+	TK_KBD_STATE,	/* <modifiers hex>[,<bitmap hex>] */
+	TK_TEXT,	/* text with \n, \t and \\ escapes */
+	TK_ABS,		/* <x>,<y> */
+	TK_REL,		/* <dx>,<dy> */
+	TK_WHEEL,	/* <delta> */
+	TK_SEQ,		/* <seq> */
+	TK_STREAM,	/* 0 or 1 */
+	TK_CMD,		/* <n> */
+};
+
+/* relay_text_state.flags */
+#define TS_BAD		(1u << 0)	/* no ':' after device and action */
+#define TS_FAIL		(1u << 1)	/* payload does not parse */
+#define TS_DONE		(1u << 2)	/* payload complete, rest is ignored */
+#define TS_DIGITS	(1u << 3)	/* current field has digits */
+#define TS_SIGN		(1u << 4)	/* current field has a sign */
+#define TS_NEG		(1u << 5)	/* ... and it is '-' */
+#define TS_ESC		(1u << 6)	/* text: backslash pending */
+
+static void text_pos_add(struct relay_text_state *ts, size_t n)
+{
+	size_t pos = ts->pos + n;
+
+	ts->pos = pos > UINT8_MAX ? UINT8_MAX : (uint8_t)pos;
+}
+
+static uint8_t token_kind(char device, char action)
+{
+	switch (device) {
+	case 'K':
+		return action == 'T' ? TK_TEXT :
+		       action == 'S' ? TK_KBD_STATE : TK_KEY;
+	case 'M': return TK_ABS;
+	case 'R': return TK_REL;
+	case 'W': return action == 'W' ? TK_WHEEL : TK_UNKNOWN;
+	case 'S':
+		return action == 'Q' ? TK_SEQ :
+		       action == 'M' ? TK_STREAM : TK_CMD;
+	default:  return TK_UNKNOWN;
+	}
+}
+
+static int digit_value(uint8_t c, unsigned int base)
+{
+	int d;
+
+	if (c >= '0' && c <= '9') {
+		d = c - '0';
+	} else if ((c | 0x20) >= 'a' && (c | 0x20) <= 'f') {
+		d = (c | 0x20) - 'a' + 10;
+	} else {
+		return -1;
+	}
+	return d < (int)base ? d : -1;
+}
+
+/*
+ * One byte of a numeric payload: up to @p nfields comma separated
+ * integers, each with optional leading blanks and sign like sscanf()
+ * takes them. Magnitudes saturate at INT32_MAX; anything after the last
+ * field is ignored.
+ */
+static void number_byte(struct relay_text_state *ts, uint8_t c,
+			uint8_t nfields, unsigned int base)
+{
+	int d = digit_value(c, base);
+
+	if (ts->flags & (TS_DONE | TS_FAIL)) {
+		return;
+	}
+
+	if (d >= 0) {
+		uint32_t v = ts->val[ts->field];
+
+		ts->val[ts->field] = v > (INT32_MAX - (uint32_t)d) / base ?
+				     INT32_MAX : v * base + (uint32_t)d;
+		ts->flags |= TS_DIGITS;
+		return;
+	}
+
+	if (!(ts->flags & TS_DIGITS)) {
+		if (c == ' ' && !(ts->flags & TS_SIGN)) {
+			return;
+		}
+		if ((c == '-' || c == '+') && !(ts->flags & TS_SIGN)) {
+			ts->flags |= TS_SIGN | (c == '-' ? TS_NEG : 0);
+			return;
+		}
+		ts->flags |= TS_FAIL;
+		return;
+	}
+
+	/* End of a field */
+	if (ts->flags & TS_NEG) {
+		ts->val[ts->field] = 0u - ts->val[ts->field];
+	}
+	if (c == ',' && ts->field + 1 < nfields) {
+		ts->field++;
+		ts->flags &= (uint8_t)~(TS_DIGITS | TS_SIGN | TS_NEG);
+	} else if (ts->field + 1 == nfields) {
+		ts->flags |= TS_DONE;
+	} else {
+		ts->flags |= TS_FAIL;
+	}
+}
+
+/* Close the last field at the end of the token; false if it is missing */
+static bool number_close(struct relay_text_state *ts, uint8_t nfields)
+{
+	number_byte(ts, '\n', nfields, 10);
+	return (ts->flags & (TS_DONE | TS_FAIL)) == TS_DONE;
+}
+
+/*
+ * One byte of a KS: bitmap, two hex digits per byte starting at usage 0;
+ * val[1] counts the digits. Anything after the bitmap is ignored.
+ */
+static void kbd_state_byte(struct relay_text_state *ts, uint8_t c)
+{
+	int d = digit_value(c, 16);
+	uint32_t n = ts->val[1];
+
+	if (ts->flags & (TS_DONE | TS_FAIL)) {
+		return;
+	}
+	if (d < 0) {
+		ts->flags |= TS_DONE;
+		return;
+	}
+	if (n >= 2 * RELAY_KBD_BITMAP_SIZE) {
+		ts->flags |= TS_FAIL;
+		return;
+	}
+	ts->keys[n >> 1] |= (uint8_t)(d << ((n & 1) ? 0 : 4));
+	ts->val[1] = n + 1;
+}
+
+static void header_byte(struct relay_text_state *ts, uint8_t c)
+{
+	switch (ts->pos++) {
+	case 0:
+		ts->device = (char)c;
+		break;
+	case 1:
+		ts->action = (char)c;
+		break;
+	default:
+		if (c != ':') {
+			ts->flags |= TS_BAD;
+		}
+		ts->kind = token_kind(ts->device, ts->action);
+		break;
+	}
+}
+
+static void payload_byte(struct relay_text_state *ts, uint8_t c)
+{
+	uint8_t idx = ts->pos - 3;
+
+	text_pos_add(ts, 1);
+	if (ts->flags & TS_BAD) {
+		return;
+	}
+
+	switch (ts->kind) {
+	case TK_KEY:
+		if (idx < 2) {
+			if (c != (uint8_t)"0x"[idx]) {
+				ts->flags |= TS_FAIL;
+			}
+			return;
+		}
+		number_byte(ts, c, 1, 16);
+		break;
+	case TK_KBD_STATE:
+		if (ts->field == 0) {
+			number_byte(ts, c, 2, 16);
+		} else {
+			kbd_state_byte(ts, c);
+		}
+		break;
+	case TK_ABS:
+	case TK_REL:
+		number_byte(ts, c, 2, 10);
+		break;
+	case TK_WHEEL:
+	case TK_SEQ:
+	case TK_STREAM:
+	case TK_CMD:
+		number_byte(ts, c, 1, 10);
+		break;
+	default:
+		break;
+	}
+}
+
+static void text_piece(struct relay_core *core, const uint8_t *data,
+		       size_t len, void *ctx)
+{
+	struct relay_input in = { .type = RELAY_IN_TEXT };
+
+	if (len == 0) {
+		return;
+	}
+	in.text.data = data;
+	in.text.len = (uint16_t)len;
+	relay_core_input(core, &in, ctx);
+}
+
+/* KT payload up to the next '\n' or the end of the write */
+static const uint8_t *text_payload(struct relay_core *core,
+				   struct relay_text_state *ts,
+				   const uint8_t *p, const uint8_t *end,
+				   void *ctx)
+{
+	static const uint8_t newline = '\n';
+	static const uint8_t tab = '\t';
+	const uint8_t *run = p;
+
+	if (ts->flags & TS_ESC) {
+		ts->flags &= (uint8_t)~TS_ESC;
+		text_piece(core, *p == 'n' ? &newline : *p == 't' ? &tab : p, 1,
+			   ctx);
+		text_pos_add(ts, 1);
+		return p + 1;
+	}
+
+	while (p < end && *p != '\n' && *p != '\\') {
+		p++;
+	}
+	text_piece(core, run, (size_t)(p - run), ctx);
+	text_pos_add(ts, (size_t)(p - run));
+
+	if (p < end && *p == '\\') {
+		ts->flags |= TS_ESC;
+		text_pos_add(ts, 1);
+		p++;
+	}
+	return p;
+}
+
+/* Button mask for a mouse token action letter, -1 if unknown */
+static int mouse_action_buttons(char action)
+{
+	switch (action) {
+	case 'L': return 1;        /* left press / drag */
+	case 'R': return 2;        /* right press / drag */
+	case 'M': return 0;        /* move, no button held */
+	case 'S':                  /* left release */
+	case 'E': return 0;        /* right release */
+	default:  return -1;
+	}
+}
+
+/* Apply the token parsed so far and start the next; returns inputs applied */
+static int token_end(struct relay_core *core, struct relay_text_state *ts,
+		     void *ctx)
+{
+	struct relay_input in;
+	bool stream = ts->stream;
+	int count = 0;
+	int button;
+
+	if (ts->pos == 0) {
+		return 0;
+	}
+
+	/* Wire format: <device><action>:<payload> — minimum 4 bytes
+	 * (e.g. "MM:0"). */
+	if (ts->pos < 4 || (ts->flags & TS_BAD)) {
+		core_event(core, ctx, RELAY_EV_MALFORMED, 0);
+		goto out;
+	}
+
+	switch (ts->kind) {
+	case TK_KEY:
+		if (!number_close(ts, 1)) {
+			goto out;
+		}
+		in.type = RELAY_IN_KEY;
+		in.key.qt_key = ts->val[0];
+		in.key.press = (ts->action == 'P');
+		break;
+	case TK_KBD_STATE:
+		if (ts->field == 0 ? !number_close(ts, 1) :
+		    (ts->flags & TS_FAIL) || (ts->val[1] & 1)) {
+			goto out;
+		}
+		in.type = RELAY_IN_KBD_STATE;
+		in.kbd_state.modifiers = (uint8_t)ts->val[0];
+		in.kbd_state.keys = ts->keys;
+		in.kbd_state.len = (uint8_t)(ts->val[1] / 2);
+		break;
+	case TK_TEXT:
+		/* A trailing backslash is kept as is */
+		if (ts->flags & TS_ESC) {
+			text_piece(core, (const uint8_t *)"\\", 1, ctx);
+		}
+		count = 1;
+		goto out;
+	case TK_ABS:
+		button = mouse_action_buttons(ts->action);
+		if (!number_close(ts, 2) || button < 0) {
+			goto out;
+		}
+		in.type = RELAY_IN_MOUSE_ABS;
+		in.mouse.buttons = (uint8_t)button;
+		in.mouse.x = (uint16_t)ts->val[0];
+		in.mouse.y = (uint16_t)ts->val[1];
+		break;
+	case TK_REL:
+		button = mouse_action_buttons(ts->action);
+		if (!number_close(ts, 2) || button < 0) {
+			goto out;
+		}
+		in.type = RELAY_IN_MOUSE_REL;
+		in.rel.buttons = (uint8_t)button;
+		in.rel.dx = (int16_t)CLAMP_I((int32_t)ts->val[0], -32767, 32767);
+		in.rel.dy = (int16_t)CLAMP_I((int32_t)ts->val[1], -32767, 32767);
+		break;
+	case TK_WHEEL:
+		if (!number_close(ts, 1)) {
+			goto out;
+		}
+		in.type = RELAY_IN_WHEEL;
+		in.wheel.delta = (int8_t)CLAMP_I((int32_t)ts->val[0], -127, 127);
+		break;
+	case TK_SEQ:
+		if (!number_close(ts, 1)) {
+			goto out;
+		}
+		in.type = RELAY_IN_SEQ;
+		in.seq.seq = (uint16_t)ts->val[0];
+		break;
+	case TK_STREAM:
+		if (number_close(ts, 1)) {
+			stream = (ts->val[0] != 0);
+		}
+		goto out;
+	case TK_CMD:
+	{
+		uint32_t arg = number_close(ts, 1) ? ts->val[0] : 0;
+
+		if (!core->ops->command ||
+		    !core->ops->command(ctx, ts->action, arg)) {
+			core_event(core, ctx, RELAY_EV_UNKNOWN_CMD, 0);
+		}
+		goto out;
+	}
+	default:
+		core_event(core, ctx, RELAY_EV_UNKNOWN_CMD, 0);
+		goto out;
+	}
+
+	relay_core_input(core, &in, ctx);
+	count = 1;
+out:
+	memset(ts, 0, sizeof(*ts));
+	ts->stream = stream;
+	return count;
+}
+
+static int text_feed(struct relay_core *core, struct relay_text_state *ts,
+		     const uint8_t *p, size_t len, void *ctx)
+{
+	const uint8_t *end = p + len;
+	int count = 0;
+
+	while (p < end) {
+		if (*p == '\n') {
+			count += token_end(core, ts, ctx);
+			p++;
+		} else if (ts->pos < 3) {
+			header_byte(ts, *p++);
+		} else if (ts->kind == TK_TEXT && !(ts->flags & TS_BAD)) {
+			p = text_payload(core, ts, p, end, ctx);
+		} else {
+			payload_byte(ts, *p++);
+		}
+	}
+
+	if (!ts->stream) {
+		count += token_end(core, ts, ctx);
+	}
+	return count;
+}
+
+static void core_input_cb(const struct relay_input *in, void *arg)
+{
+	struct core_call *call = arg;
+
+	relay_core_input(call->core, in, call->ctx);
+}
+
+static int bin_feed(struct relay_core *core, const uint8_t *buf, size_t len,
+		    void *ctx)
+{
+	struct core_call call = { .core = core, .ctx = ctx };
+	int err = relay_proto_decode(buf, len, core_input_cb, &call);
+
+	if (err < 0) {
+		core_event(core, ctx, RELAY_EV_MALFORMED, (uint32_t)err);
+	}
+	return err;
+}
+
+int relay_core_feed(struct relay_core *core, const void *data, size_t len,
+		    void *ctx)
+{
+	/* Binary frames only start between tokens */
+	if (core->text.pos == 0 && relay_proto_is_binary(data, len)) {
+		return bin_feed(core, data, len, ctx);
+	}
+
+	return text_feed(core, &core->text, data, len, ctx);
+}
+
+void relay_core_resync(struct relay_core *core)
+{
+	memset(&core->text, 0, sizeof(core->text));
+}
+
+/*
+ * One byte of a binary frame on a byte stream. Records are collected
+ * behind the frame header and decoded one by one; a byte that cannot
+ * start a record ends the frame.
+ *
+ * @return false if @p c is not part of the frame
+ */
+static bool stream_bin_byte(struct relay_core *core, struct relay_stream *st,
+			    uint8_t c, void *ctx, int *count)
+{
+	int rlen;
+	int n;
+
+	if (st->bin_len == 1) {
+		if (c & RELAY_PROTO_BIN_FLAG) {
+			/* Next frame, possibly another version */
+			st->bin[0] = c;
+			return true;
+		}
+		if (relay_proto_record_len(&c, 1) < 0) {
+			st->bin_len = 0;
+			return false;
+		}
+	}
+
+	st->bin[st->bin_len++] = c;
+	rlen = relay_proto_record_len(&st->bin[1], st->bin_len - 1);
+	if (rlen < 0) {
+		/* Oversized KBD_STATE, the rest of it is not a record */
+		core_event(core, ctx, RELAY_EV_MALFORMED, (uint32_t)rlen);
+		st->bin_len = 0;
+	} else if (rlen > 0 && st->bin_len == 1 + rlen) {
+		n = bin_feed(core, st->bin, st->bin_len, ctx);
+		if (n > 0) {
+			*count += n;
+		}
+		st->bin_len = 1;
+	}
+	return true;
+}
+
+int relay_core_feed_stream(struct relay_core *core, struct relay_stream *st,
+			   const void *data, size_t len, void *ctx)
+{
+	const uint8_t *p = data;
+	const uint8_t *end = p + len;
+	int count = 0;
+
+	/* No write boundaries, so '\n' is the only token end */
+	st->text.stream = true;
+
+	while (p < end) {
+		const uint8_t *run = p;
+
+		if (st->bin_len > 0) {
+			if (stream_bin_byte(core, st, *p, ctx, &count)) {
+				p++;
+			}
+			continue;
+		}
+		if (st->text.pos == 0 && (*p & RELAY_PROTO_BIN_FLAG)) {
+			st->bin[0] = *p++;
+			st->bin_len = 1;
+			continue;
+		}
+
+		/* Text through the next '\n', where a frame may start */
+		while (p < end && *p++ != '\n') {
+		}
+		count += text_feed(core, &st->text, run, (size_t)(p - run),
+				   ctx);
+		st->text.stream = true;
+	}
+	return count;
+}
+
+void relay_core_stream_reset(struct relay_stream *st)
+{
+	memset(st, 0, sizeof(*st));
+}
@@ -0,0 +1,163 @@
+/*
+ * HID Relay input core
+ *
+ * Turns writes from the RX characteristic (text tokens or binary frames)
+ * into keyboard and mouse state, and hands the resulting reports to a
+ * sink. The firmware sink queues them on the USB HID endpoints; the host
+ * tools plug in a mock sink that records them.
+ *
+ * This header and relay_core.c have no Zephyr dependencies.
+ */
+
+#ifndef RELAY_CORE_H
+#define RELAY_CORE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "relay_proto.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bitmap of pressed key usages, bit (usage & 7) of byte (usage >> 3) */
+#define RELAY_KBD_BITMAP_SIZE	32
+
+/* Things the sink may want to react to besides reports */
+enum relay_core_event {
+	RELAY_EV_PARSED,	/* an input was decoded, before it is applied */
+	RELAY_EV_APPLIED,	/* an input changed the HID state */
+	RELAY_EV_UNKNOWN_KEY,	/* arg: Qt key code with no HID mapping */
+	RELAY_EV_UNSUPPORTED,	/* arg: enum relay_input_type the sink lacks */
+	RELAY_EV_MALFORMED,	/* arg: error from the binary decoder, or 0 */
+	RELAY_EV_UNKNOWN_CMD,	/* text token with an unknown device letter */
+};
+
+/**
+ * @brief Report sink
+ *
+ * @p ctx is the value passed to relay_core_feed(). Callbacks run in the
+ * caller's context; the core itself never blocks.
+ */
+struct relay_core_ops {
+	/** Full keyboard state; @p keys is a RELAY_KBD_BITMAP_SIZE bitmap */
+	bool (*kbd)(void *ctx, uint8_t modifiers, const uint8_t *keys);
+	bool (*mouse_abs)(void *ctx, uint8_t buttons, uint16_t x, uint16_t y,
+			  int8_t wheel);
+	/** Optional; relative input raises RELAY_EV_UNSUPPORTED without it */
+	bool (*mouse_rel)(void *ctx, uint8_t buttons, int16_t dx, int16_t dy);
+	/**
+	 * Consumer control usage held down, 0 on release; optional. Without
+	 * it media keys go through the keyboard table like any other key.
+	 */
+	bool (*consumer)(void *ctx, uint16_t usage);
+	/**
+	 * "S<action>:<n>" status/control tokens, optional. @p arg is the
+	 * decimal payload, 0 if there is none. Returns false for an unknown
+	 * action.
+	 */
+	bool (*command)(void *ctx, char action, uint32_t arg);
+	/**
+	 * Sequence marker from the host, optional. Every input that came
+	 * before it has been handed to the sink by the time this is called.
+	 */
+	void (*seq)(void *ctx, uint16_t seq);
+	/**
+	 * UTF-8 text to type on the device, optional. Returns the number of
+	 * bytes accepted. A text token may arrive in several pieces, and a
+	 * piece may end in the middle of a character.
+	 */
+	size_t (*text)(void *ctx, const uint8_t *utf8, size_t len);
+	/** Optional */
+	void (*event)(void *ctx, enum relay_core_event ev, uint32_t arg);
+};
+
+/* Text token parser state, carried from one write to the next */
+struct relay_text_state {
+	uint8_t pos;		/* token bytes seen, saturates at 255 */
+	uint8_t kind;		/* payload syntax, from device and action */
+	uint8_t field;		/* numeric payload field being parsed */
+	uint8_t flags;
+	char device;
+	char action;
+	uint32_t val[2];
+	uint8_t keys[RELAY_KBD_BITMAP_SIZE];	/* KS: bitmap so far */
+	bool stream;		/* SM:1 - tokens may span writes */
+};
+
+/* Largest binary record, opcode included (TEXT) */
+#define RELAY_STREAM_RECORD_MAX	(2 + RELAY_PROTO_TEXT_MAX)
+
+/*
+ * Parser state for a byte stream (CDC ACM) with no write boundaries to
+ * go by: text tokens always end at '\n' and binary frames are taken
+ * apart record by record as the bytes arrive.
+ */
+struct relay_stream {
+	struct relay_text_state text;
+	uint16_t bin_len;	/* frame header + record bytes, 0 outside one */
+	uint8_t bin[1 + RELAY_STREAM_RECORD_MAX];
+};
+
+struct relay_core {
+	const struct relay_core_ops *ops;
+	uint8_t keys[RELAY_KBD_BITMAP_SIZE];
+	uint8_t modifiers;
+	uint16_t x;
+	uint16_t y;
+	uint16_t consumer;
+	struct relay_text_state text;
+};
+
+void relay_core_init(struct relay_core *core, const struct relay_core_ops *ops);
+
+/** @brief Apply one decoded input event */
+void relay_core_input(struct relay_core *core, const struct relay_input *in,
+		      void *ctx);
+
+/**
+ * @brief Process one write, text or binary
+ *
+ * Text is parsed in place as it arrives. By default the end of a write
+ * also ends its last token. After an "SM:1" token the host terminates
+ * every token with '\n' instead, and a token may be split across writes
+ * at any byte; a write is only taken as binary when no token is pending.
+ *
+ * @return number of inputs completed, or a negative decoder error
+ */
+int relay_core_feed(struct relay_core *core, const void *data, size_t len,
+		    void *ctx);
+
+/**
+ * @brief Drop a partially received token and leave streaming mode
+ *
+ * For when the writer goes away; key state is kept.
+ */
+void relay_core_resync(struct relay_core *core);
+
+/**
+ * @brief Process bytes from a byte stream transport
+ *
+ * Same inputs as relay_core_feed(), cut at any byte. Tokens must end
+ * with '\n' (streaming mode always applies). A binary frame starts with
+ * a header byte between tokens and ends at the first byte that does not
+ * start a record, so text can follow it directly. Like the parser
+ * state in @p st, the key and button state in @p core belongs to this
+ * writer alone; which writer a HID device shows is up to the caller
+ * (main.c arbitrates with input_owner).
+ *
+ * @return number of inputs completed
+ */
+int relay_core_feed_stream(struct relay_core *core, struct relay_stream *st,
+			   const void *data, size_t len, void *ctx);
+
+/** @brief Forget a partial token or frame, e.g. when the port closes */
+void relay_core_stream_reset(struct relay_stream *st);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RELAY_CORE_H */
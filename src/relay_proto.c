@@ -0,0 +1,269 @@
+/*
+ * HID Relay wire protocol - binary encoder/decoder
+ */
+
+#include "relay_proto.h"
+
+#include <errno.h>
+#include <string.h>
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+	return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+	p[0] = (uint8_t)(v & 0xFF);
+	p[1] = (uint8_t)(v >> 8);
+}
+
+/* Record length including the opcode, 0 for unknown opcodes */
+static size_t record_len(uint8_t op)
+{
+	switch (op) {
+	case RELAY_OP_KEY_PRESS:
+	case RELAY_OP_KEY_RELEASE:
+	case RELAY_OP_SEQ:
+		return 3;
+	case RELAY_OP_MOUSE_REL8:
+		return 4;
+	case RELAY_OP_MOUSE_ABS:
+	case RELAY_OP_MOUSE_REL:
+		return 6;
+	case RELAY_OP_WHEEL:
+		return 2;
+	default:
+		return 0;
+	}
+}
+
+int relay_proto_record_len(const uint8_t *rec, size_t avail)
+{
+	size_t fixed;
+
+	if (avail == 0) {
+		return 0;
+	}
+
+	/* TEXT and KBD_STATE carry their own length */
+	switch (rec[0]) {
+	case RELAY_OP_TEXT:
+		return avail < 2 ? 0 : 2 + rec[1];
+	case RELAY_OP_KBD_STATE:
+		if (avail < 3) {
+			return 0;
+		}
+		return rec[2] <= RELAY_PROTO_KBD_STATE_MAX ? 3 + rec[2] :
+		       -EBADMSG;
+	default:
+		fixed = record_len(rec[0]);
+		return fixed ? (int)fixed : -EBADMSG;
+	}
+}
+
+bool relay_proto_pack_key(uint32_t qt_key, uint16_t *packed)
+{
+	if (qt_key < RELAY_KEY_SPECIAL_FLAG) {
+		*packed = (uint16_t)qt_key;
+		return true;
+	}
+	if ((qt_key & ~0x7FFFu) == RELAY_QT_SPECIAL_BASE) {
+		*packed = (uint16_t)(RELAY_KEY_SPECIAL_FLAG | (qt_key & 0x7FFF));
+		return true;
+	}
+	return false;
+}
+
+uint32_t relay_proto_unpack_key(uint16_t packed)
+{
+	if (packed & RELAY_KEY_SPECIAL_FLAG) {
+		return RELAY_QT_SPECIAL_BASE | (packed & 0x7FFF);
+	}
+	return packed;
+}
+
+int relay_proto_decode(const uint8_t *buf, size_t len,
+		       relay_input_cb_t cb, void *ctx)
+{
+	struct relay_input in;
+	size_t pos = 1;
+	int count = 0;
+
+	if (!relay_proto_is_binary(buf, len)) {
+		return -EBADMSG;
+	}
+	if ((buf[0] & ~RELAY_PROTO_BIN_FLAG) != RELAY_PROTO_VERSION) {
+		return -ENOTSUP;
+	}
+
+	while (pos < len) {
+		const uint8_t *rec = buf + pos;
+		int rlen = relay_proto_record_len(rec, len - pos);
+
+		if (rlen <= 0 || pos + (size_t)rlen > len) {
+			return -EBADMSG;
+		}
+
+		switch (rec[0]) {
+		case RELAY_OP_KEY_PRESS:
+		case RELAY_OP_KEY_RELEASE:
+			in.type = RELAY_IN_KEY;
+			in.key.qt_key = relay_proto_unpack_key(get_le16(rec + 1));
+			in.key.press = (rec[0] == RELAY_OP_KEY_PRESS);
+			break;
+		case RELAY_OP_KBD_STATE:
+			in.type = RELAY_IN_KBD_STATE;
+			in.kbd_state.modifiers = rec[1];
+			in.kbd_state.len = rec[2];
+			in.kbd_state.keys = rec + 3;
+			break;
+		case RELAY_OP_MOUSE_ABS:
+			in.type = RELAY_IN_MOUSE_ABS;
+			in.mouse.buttons = rec[1];
+			in.mouse.x = get_le16(rec + 2);
+			in.mouse.y = get_le16(rec + 4);
+			break;
+		case RELAY_OP_MOUSE_REL8:
+			in.type = RELAY_IN_MOUSE_REL;
+			in.rel.buttons = rec[1];
+			in.rel.dx = (int8_t)rec[2];
+			in.rel.dy = (int8_t)rec[3];
+			break;
+		case RELAY_OP_MOUSE_REL:
+			in.type = RELAY_IN_MOUSE_REL;
+			in.rel.buttons = rec[1];
+			in.rel.dx = (int16_t)get_le16(rec + 2);
+			in.rel.dy = (int16_t)get_le16(rec + 4);
+			break;
+		case RELAY_OP_WHEEL:
+			in.type = RELAY_IN_WHEEL;
+			in.wheel.delta = (int8_t)rec[1];
+			break;
+		case RELAY_OP_SEQ:
+			in.type = RELAY_IN_SEQ;
+			in.seq.seq = get_le16(rec + 1);
+			break;
+		case RELAY_OP_TEXT:
+			in.type = RELAY_IN_TEXT;
+			in.text.data = rec + 2;
+			in.text.len = rec[1];
+			break;
+		}
+
+		cb(&in, ctx);
+		count++;
+		pos += rlen;
+	}
+
+	return count;
+}
+
+size_t relay_proto_enc_header(uint8_t *buf, size_t cap)
+{
+	if (cap < 1) {
+		return 0;
+	}
+	buf[0] = RELAY_PROTO_BIN_HDR;
+	return 1;
+}
+
+size_t relay_proto_enc_key(uint8_t *buf, size_t cap, uint32_t qt_key,
+			   bool press)
+{
+	uint16_t packed;
+
+	if (cap < 3 || !relay_proto_pack_key(qt_key, &packed)) {
+		return 0;
+	}
+	buf[0] = press ? RELAY_OP_KEY_PRESS : RELAY_OP_KEY_RELEASE;
+	put_le16(buf + 1, packed);
+	return 3;
+}
+
+size_t relay_proto_enc_mouse_abs(uint8_t *buf, size_t cap, uint8_t buttons,
+				 uint16_t x, uint16_t y)
+{
+	if (cap < 6) {
+		return 0;
+	}
+	buf[0] = RELAY_OP_MOUSE_ABS;
+	buf[1] = buttons;
+	put_le16(buf + 2, x);
+	put_le16(buf + 4, y);
+	return 6;
+}
+
+size_t relay_proto_enc_mouse_rel(uint8_t *buf, size_t cap, uint8_t buttons,
+				 int16_t dx, int16_t dy)
+{
+	if (dx >= INT8_MIN && dx <= INT8_MAX && dy >= INT8_MIN && dy <= INT8_MAX) {
+		if (cap < 4) {
+			return 0;
+		}
+		buf[0] = RELAY_OP_MOUSE_REL8;
+		buf[1] = buttons;
+		buf[2] = (uint8_t)(int8_t)dx;
+		buf[3] = (uint8_t)(int8_t)dy;
+		return 4;
+	}
+
+	if (cap < 6) {
+		return 0;
+	}
+	buf[0] = RELAY_OP_MOUSE_REL;
+	buf[1] = buttons;
+	put_le16(buf + 2, (uint16_t)dx);
+	put_le16(buf + 4, (uint16_t)dy);
+	return 6;
+}
+
+size_t relay_proto_enc_wheel(uint8_t *buf, size_t cap, int8_t delta)
+{
+	if (cap < 2) {
+		return 0;
+	}
+	buf[0] = RELAY_OP_WHEEL;
+	buf[1] = (uint8_t)delta;
+	return 2;
+}
+
+size_t relay_proto_enc_seq(uint8_t *buf, size_t cap, uint16_t seq)
+{
+	if (cap < 3) {
+		return 0;
+	}
+	buf[0] = RELAY_OP_SEQ;
+	put_le16(buf + 1, seq);
+	return 3;
+}
+
+size_t relay_proto_enc_text(uint8_t *buf, size_t cap, const char *text,
+			    size_t len)
+{
+	if (len > RELAY_PROTO_TEXT_MAX || cap < 2 + len) {
+		return 0;
+	}
+	buf[0] = RELAY_OP_TEXT;
+	buf[1] = (uint8_t)len;
+	memcpy(buf + 2, text, len);
+	return 2 + len;
+}
+
+size_t relay_proto_enc_kbd_state(uint8_t *buf, size_t cap, uint8_t modifiers,
+				 const uint8_t *keys)
+{
+	size_t len = RELAY_PROTO_KBD_STATE_MAX;
+
+	while (len > 0 && keys[len - 1] == 0) {
+		len--;
+	}
+	if (cap < 3 + len) {
+		return 0;
+	}
+	buf[0] = RELAY_OP_KBD_STATE;
+	buf[1] = modifiers;
+	buf[2] = (uint8_t)len;
+	memcpy(buf + 3, keys, len);
+	return 3 + len;
+}
@@ -0,0 +1,195 @@
+/*
+ * HID Relay wire protocol
+ *
+ * Two encodings travel over the RX characteristic:
+ *
+ *  - Text (legacy): newline separated "<device><action>:<payload>" tokens,
+ *    e.g. "KP:0x41\n" or "MM:12345,6789\n".
+ *  - Binary (v1): a single header byte followed by packed records.
+ *
+ * A write whose first byte has bit 7 set is binary; text tokens always
+ * start with an ASCII device letter, so old hosts keep working unchanged.
+ * On a byte stream (CDC ACM) a frame instead ends at the first byte that
+ * does not start a record: opcodes stay below 'A', device letters do not.
+ *
+ * Binary layout (all multi-byte fields little-endian):
+ *
+ *   header        0x80 | RELAY_PROTO_VERSION
+ *   KEY_PRESS     0x01 key:u16
+ *   KEY_RELEASE   0x02 key:u16
+ *   KBD_STATE     0x03 modifiers:u8 len:u8 keys[len]
+ *   MOUSE_ABS     0x10 buttons:u8 x:u16 y:u16
+ *   MOUSE_REL8    0x11 buttons:u8 dx:i8 dy:i8
+ *   MOUSE_REL     0x12 buttons:u8 dx:i16 dy:i16
+ *   WHEEL         0x20 delta:i8
+ *   SEQ           0x30 seq:u16
+ *   TEXT          0x40 len:u8 utf8[len]
+ *
+ * KBD_STATE is the complete keyboard state: a bitmap of pressed HID
+ * usages (bit (usage & 7) of keys[usage >> 3]) with trailing zero bytes
+ * left out, and the HID modifier byte. The dongle diffs it against what
+ * it has and reports only the change, so a chord is one record and a
+ * periodic snapshot repairs a lost release.
+ *
+ * SEQ carries no input; the dongle echoes the last one it has processed
+ * in its "FC:" flow-control notification. TEXT is typed on the device
+ * (see kbd_type.h).
+ *
+ * Key codes are Qt key codes packed into 16 bits: Latin-1 codes are sent
+ * as-is, codes from the 0x01000000 special-key block are sent as
+ * 0x8000 | (code & 0x7fff).
+ *
+ * This header and relay_proto.c have no Zephyr dependencies so the host
+ * application can build the same encoder/decoder.
+ */
+
+#ifndef RELAY_PROTO_H
+#define RELAY_PROTO_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RELAY_PROTO_VERSION	1
+#define RELAY_PROTO_BIN_FLAG	0x80
+#define RELAY_PROTO_BIN_HDR	(RELAY_PROTO_BIN_FLAG | RELAY_PROTO_VERSION)
+
+#define RELAY_OP_KEY_PRESS	0x01
+#define RELAY_OP_KEY_RELEASE	0x02
+#define RELAY_OP_KBD_STATE	0x03
+#define RELAY_OP_MOUSE_ABS	0x10
+#define RELAY_OP_MOUSE_REL8	0x11
+#define RELAY_OP_MOUSE_REL	0x12
+#define RELAY_OP_WHEEL		0x20
+#define RELAY_OP_SEQ		0x30
+#define RELAY_OP_TEXT		0x40
+
+#define RELAY_QT_SPECIAL_BASE	0x01000000u
+#define RELAY_KEY_SPECIAL_FLAG	0x8000u
+
+/* Largest fixed-size record, opcode included */
+#define RELAY_PROTO_MAX_RECORD	6
+/* Largest TEXT payload */
+#define RELAY_PROTO_TEXT_MAX	255
+/* KBD_STATE bitmap bytes, usages 0x00..0xff */
+#define RELAY_PROTO_KBD_STATE_MAX	32
+
+enum relay_input_type {
+	RELAY_IN_KEY,
+	RELAY_IN_MOUSE_ABS,
+	RELAY_IN_MOUSE_REL,
+	RELAY_IN_WHEEL,
+	RELAY_IN_SEQ,
+	RELAY_IN_TEXT,
+	RELAY_IN_KBD_STATE,
+};
+
+/** @brief One decoded input event, independent of the wire encoding */
+struct relay_input {
+	enum relay_input_type type;
+	union {
+		struct {
+			uint32_t qt_key;
+			bool press;
+		} key;
+		struct {
+			uint8_t buttons;
+			uint16_t x;
+			uint16_t y;
+		} mouse;
+		struct {
+			uint8_t buttons;
+			int16_t dx;
+			int16_t dy;
+		} rel;
+		struct {
+			int8_t delta;
+		} wheel;
+		struct {
+			uint16_t seq;
+		} seq;
+		struct {
+			const uint8_t *data;	/* valid during the callback */
+			uint16_t len;
+		} text;
+		struct {
+			uint8_t modifiers;
+			const uint8_t *keys;	/* valid during the callback */
+			uint8_t len;		/* bytes in keys, rest are 0 */
+		} kbd_state;
+	};
+};
+
+typedef void (*relay_input_cb_t)(const struct relay_input *in, void *ctx);
+
+/**
+ * @brief Check whether a write uses the binary encoding
+ */
+static inline bool relay_proto_is_binary(const uint8_t *buf, size_t len)
+{
+	return len > 0 && (buf[0] & RELAY_PROTO_BIN_FLAG);
+}
+
+/**
+ * @brief Decode a binary write and deliver each record to @p cb
+ *
+ * Decoding stops at the first malformed record; records before it have
+ * already been delivered.
+ *
+ * @return number of records delivered, -ENOTSUP for an unknown version,
+ *         -EBADMSG for an unknown opcode or truncated record
+ */
+int relay_proto_decode(const uint8_t *buf, size_t len,
+		       relay_input_cb_t cb, void *ctx);
+
+/**
+ * @brief Length of the record starting at @p rec, opcode included
+ *
+ * For byte streams that find record boundaries themselves.
+ *
+ * @return the length, 0 if @p avail bytes are too few to tell, -EBADMSG
+ *         for an unknown opcode or an oversized KBD_STATE
+ */
+int relay_proto_record_len(const uint8_t *rec, size_t avail);
+
+/**
+ * @brief Pack a Qt key code into its 16-bit wire form
+ *
+ * @return false if the key cannot be represented
+ */
+bool relay_proto_pack_key(uint32_t qt_key, uint16_t *packed);
+
+/** @brief Inverse of relay_proto_pack_key() */
+uint32_t relay_proto_unpack_key(uint16_t packed);
+
+/*
+ * Encoders. Each writes into @p buf and returns the number of bytes
+ * written, or 0 if @p cap is too small or the value is not encodable.
+ * A frame is a header followed by any number of records.
+ */
+size_t relay_proto_enc_header(uint8_t *buf, size_t cap);
+size_t relay_proto_enc_key(uint8_t *buf, size_t cap, uint32_t qt_key,
+			   bool press);
+size_t relay_proto_enc_mouse_abs(uint8_t *buf, size_t cap, uint8_t buttons,
+				 uint16_t x, uint16_t y);
+/* Uses the 8-bit record when both deltas fit */
+size_t relay_proto_enc_mouse_rel(uint8_t *buf, size_t cap, uint8_t buttons,
+				 int16_t dx, int16_t dy);
+size_t relay_proto_enc_wheel(uint8_t *buf, size_t cap, int8_t delta);
+size_t relay_proto_enc_seq(uint8_t *buf, size_t cap, uint16_t seq);
+/* Up to RELAY_PROTO_TEXT_MAX bytes; split longer text across records */
+size_t relay_proto_enc_text(uint8_t *buf, size_t cap, const char *text,
+			    size_t len);
+/* @p keys is a full RELAY_PROTO_KBD_STATE_MAX byte bitmap */
+size_t relay_proto_enc_kbd_state(uint8_t *buf, size_t cap, uint8_t modifiers,
+				 const uint8_t *keys);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* RELAY_PROTO_H */
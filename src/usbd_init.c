@@ -0,0 +1,114 @@
+/*
+ * HID Relay USB device setup for the usbd (device_next) stack
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(usbd_init, CONFIG_HIDRELAY_HID_LOG_LEVEL);
+
+#include <zephyr/usb/usbd.h>
+#include <zephyr/usb/bos.h>
+#include "hid_km.h"
+#include "usbd_init.h"
+
+/* Same identity as the legacy stack build, see prj.conf */
+#define RELAY_USB_VID		0x2fe3
+#define RELAY_USB_PID		0x0003
+#define RELAY_USB_MAX_POWER	125	/* 2 mA units */
+
+USBD_DEVICE_DEFINE(relay_usbd, DEVICE_DT_GET(DT_NODELABEL(zephyr_udc0)),
+		   RELAY_USB_VID, RELAY_USB_PID);
+
+USBD_DESC_LANG_DEFINE(relay_lang);
+USBD_DESC_MANUFACTURER_DEFINE(relay_mfr, "ZEPHYR");
+USBD_DESC_PRODUCT_DEFINE(relay_product, "HID BLE Relay");
+USBD_DESC_SERIAL_NUMBER_DEFINE(relay_sn);
+
+USBD_DESC_CONFIG_DEFINE(relay_fs_cfg_desc, "FS Configuration");
+USBD_CONFIGURATION_DEFINE(relay_fs_config, 0, RELAY_USB_MAX_POWER,
+			  &relay_fs_cfg_desc);
+
+static void relay_usbd_msg_cb(struct usbd_context *const ctx,
+			      const struct usbd_msg *msg)
+{
+	switch (msg->type) {
+	case USBD_MSG_VBUS_READY:
+		if (usbd_enable(ctx)) {
+			LOG_ERR("Failed to enable device support");
+		}
+		break;
+	case USBD_MSG_VBUS_REMOVED:
+		if (usbd_disable(ctx)) {
+			LOG_ERR("Failed to disable device support");
+		}
+		break;
+	case USBD_MSG_SUSPEND:
+		hid_out_set_suspended(true);
+		break;
+	case USBD_MSG_RESUME:
+	case USBD_MSG_RESET:
+		hid_out_set_suspended(false);
+		break;
+	default:
+		break;
+	}
+}
+
+int usbd_relay_enable(void)
+{
+	int err;
+
+	err = usbd_add_descriptor(&relay_usbd, &relay_lang);
+	if (!err) {
+		err = usbd_add_descriptor(&relay_usbd, &relay_mfr);
+	}
+	if (!err) {
+		err = usbd_add_descriptor(&relay_usbd, &relay_product);
+	}
+	if (!err) {
+		err = usbd_add_descriptor(&relay_usbd, &relay_sn);
+	}
+	if (err) {
+		LOG_ERR("Failed to add string descriptors (%d)", err);
+		return err;
+	}
+
+	err = usbd_add_configuration(&relay_usbd, USBD_SPEED_FS,
+				     &relay_fs_config);
+	if (err) {
+		LOG_ERR("Failed to add configuration (%d)", err);
+		return err;
+	}
+
+	/* HID instances and the CDC ACM UART, all from the devicetree */
+	err = usbd_register_all_classes(&relay_usbd, USBD_SPEED_FS, 1);
+	if (err) {
+		LOG_ERR("Failed to register classes (%d)", err);
+		return err;
+	}
+
+	/* CDC ACM uses an interface association, HID alone would not */
+	usbd_device_set_code_triple(&relay_usbd, USBD_SPEED_FS,
+				    USB_BCC_MISCELLANEOUS, 0x02, 0x01);
+
+	err = usbd_msg_register_cb(&relay_usbd, relay_usbd_msg_cb);
+	if (err) {
+		LOG_ERR("Failed to register message callback (%d)", err);
+		return err;
+	}
+
+	err = usbd_init(&relay_usbd);
+	if (err) {
+		LOG_ERR("Failed to initialize device support (%d)", err);
+		return err;
+	}
+
+	/* Otherwise enabled from the callback once VBUS shows up */
+	if (!usbd_can_detect_vbus(&relay_usbd)) {
+		err = usbd_enable(&relay_usbd);
+		if (err) {
+			LOG_ERR("Failed to enable device support (%d)", err);
+		}
+	}
+	return err;
+}
@@ -0,0 +1,31 @@
+/*
+ * HID Relay USB device setup for the usbd (device_next) stack
+ *
+ * Describes the device, adds every HID and CDC ACM instance from the
+ * devicetree to one full-speed configuration and enables it, once VBUS
+ * is present where the controller can tell. Bus suspend and resume are
+ * forwarded to the HID writer.
+ */
+
+#ifndef HIDRELAY_USBD_INIT_H_
+#define HIDRELAY_USBD_INIT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Initialize and enable the USB device
+ *
+ * Call after hid_keyboard_init(); the HID instances must be registered
+ * before the stack is initialized.
+ *
+ * @return 0 on success, negative on error
+ */
+int usbd_relay_enable(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* HIDRELAY_USBD_INIT_H_ */